@@ -0,0 +1,115 @@
+#ifndef BATCH_DECODER_H
+#define BATCH_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "IrReceiver.h"
+
+namespace IrReceiverUtils
+{
+    /**
+     * Decoder progress carried between calls to DecodePackets, so that
+     * packets split across two buffers are still decoded
+     */
+    struct BatchDecodeState
+    {
+        ReceiverStateId State = WAITING_FOR_PACKET;
+        byte BitsCaptured = 0;
+        unsigned long Code = 0UL;
+        // Time since the last accepted signal fall, accumulated over filtered glitches
+        uint32_t PendingMicros = 0;
+        // Whether the last accepted signal fall ended a frame-start gap
+        bool AfterFrameStartGap = false;
+    };
+
+    /**
+     * Decode every packet in a buffer of signal-fall intervals in one call
+     *
+     * Produces the same packets as ticking an IrPacketDecoder with each interval
+     * and reading each packet as soon as it arrives, but runs as a single loop
+     * with no per-interval virtual dispatch, for backends that buffer intervals
+     * (e.g. timer input capture into a ring buffer, or deferred decoding)
+     * The Code of repeat packets is always zero
+     *
+     * @param intervalsMicros Intervals between consecutive signal falls
+     * @param outPackets Receives the decoded packets. Every interval can complete
+     * at most one packet, so a buffer of intervalCount packets always suffices.
+     * If it fills up, decoding stops early
+     * @param state Decoder progress, carried over from the previous buffer
+     * @param noisy Whether to use the noise-tolerant profile (see IrReceiver::SetMotorActive)
+     *
+     * @returns The number of packets written to outPackets
+     */
+    size_t DecodePackets(
+        uint32_t const * const intervalsMicros,
+        size_t const intervalCount,
+        IrPacket * const outPackets,
+        size_t const maxPackets,
+        BatchDecodeState & state,
+        bool const noisy = false)
+    {
+        unsigned long const repeatHalfWindow = noisy ? NOISY_REPEAT_HALF_WINDOW : HALF_WINDOW;
+        unsigned long const agcHalfWindow = noisy ? NOISY_AGC_HALF_WINDOW : HALF_WINDOW;
+        unsigned long const glitchMicros = noisy ? GLITCH_FILTER_MICROS : 0UL;
+
+        // Work on locals so the compiler can keep them in registers
+        auto decoderState = state.State;
+        auto bitsCaptured = state.BitsCaptured;
+        auto code = state.Code;
+        auto pendingMicros = state.PendingMicros;
+        auto afterFrameStartGap = state.AfterFrameStartGap;
+        size_t packetCount = 0;
+
+        for (size_t i = 0; i < intervalCount && packetCount < maxPackets; i++)
+        {
+            pendingMicros += intervalsMicros[i];
+            if (pendingMicros < glitchMicros) continue;
+            unsigned long const deltaMicros = pendingMicros;
+            pendingMicros = 0;
+            // See WaitingForPacketState: the noisy profile only accepts packets
+            // timed from the end of an AGC burst
+            bool const timedFromFrameStart = afterFrameStartGap || !noisy;
+            afterFrameStartGap = deltaMicros >= FRAME_START_GAP_MICROS;
+
+            if (decoderState == RECEIVING_PACKET)
+            {
+                // Evaluate both windows (with a single unsigned comparison each) without
+                // short-circuiting, so that the only branch per bit is the (rarely taken)
+                // invalid interval branch, rather than one that depends on the bit value
+                bool const isZero = deltaMicros - (ZERO_DURATION - HALF_WINDOW) <= 2 * HALF_WINDOW;
+                bool const isOne = deltaMicros - (ONE_DURATION - HALF_WINDOW) <= 2 * HALF_WINDOW;
+                if (!(isZero | isOne))
+                {
+                    decoderState = WAITING_FOR_PACKET;
+                    continue;
+                }
+                code = code * 2 + isOne;
+                if (++bitsCaptured == BITS_PER_CODE)
+                {
+                    outPackets[packetCount++] = IrPacket { false, code };
+                    decoderState = WAITING_FOR_PACKET;
+                }
+            }
+            else if (!timedFromFrameStart) continue;
+            else if (WithinWindow(deltaMicros, REPEAT_DURATION, repeatHalfWindow))
+            {
+                outPackets[packetCount++] = IrPacket { true, 0UL };
+            }
+            else if (WithinWindow(deltaMicros, AGC_DURATION, agcHalfWindow))
+            {
+                decoderState = RECEIVING_PACKET;
+                bitsCaptured = 0;
+                code = 0UL;
+            }
+        }
+
+        state.State = decoderState;
+        state.BitsCaptured = bitsCaptured;
+        state.Code = code;
+        state.PendingMicros = pendingMicros;
+        state.AfterFrameStartGap = afterFrameStartGap;
+        return packetCount;
+    }
+}
+
+#endif //BATCH_DECODER_H
\ No newline at end of file
@@ -0,0 +1,134 @@
+#ifndef BATCH_IR_RECEIVER_H
+#define BATCH_IR_RECEIVER_H
+
+#include <stddef.h>
+#include "IrReceiver.h"
+
+namespace IrReceiverUtils
+{
+    /**
+     * A single carrier burst (mark) and the silence that follows it (space),
+     * as captured by timing peripherals such as the ESP32 RMT or RP2040 PIO
+     */
+    struct IrSymbol
+    {
+        unsigned int MarkMicros;
+        unsigned int SpaceMicros;
+    };
+
+    // NEC burst timings, see https://www.sbprojects.net/knowledge/ir/nec.php
+    unsigned int const AGC_MARK_MICROS = 9000;
+    unsigned int const AGC_SPACE_MICROS = 4500;
+    unsigned int const REPEAT_SPACE_MICROS = 2250;
+    unsigned int const BIT_MARK_MICROS = 560;
+    unsigned int const ZERO_SPACE_MICROS = ZERO_DURATION - BIT_MARK_MICROS;
+    unsigned int const ONE_SPACE_MICROS = ONE_DURATION - BIT_MARK_MICROS;
+    // Symbols in a full NEC code: AGC, one per bit, and the stop burst
+    size_t const SYMBOLS_PER_CODE = BITS_PER_CODE + 2;
+    // Symbols in an NEC repeat: AGC and the stop burst
+    size_t const SYMBOLS_PER_REPEAT = 2;
+
+    /**
+     * IR Receiver for NEC protocol IR data transmission, for platforms
+     * whose peripherals capture the burst timings of a whole frame in
+     * hardware and deliver them in one batch (e.g. the ESP32 RMT
+     * receive-done callback, or an RP2040 PIO FIFO drained by DMA)
+     *
+     * Batches are decoded in a single pass through the same states (and
+     * glitch filter) as InputPinIrReceiver, so decoding behaves identically
+     */
+    class BatchIrReceiver final : public IrPacketDecoder<>
+    {
+        private:
+            // Peripherals split batches at an idle gap, so the gap before a batch
+            // is unknown. Any duration longer than every window will do
+            static unsigned long const IDLE_GAP_MICROS = 2 * AGC_DURATION;
+
+            // Time of the last signal fall, relative to an arbitrary epoch
+            unsigned long signalFallMicros = 0;
+            // Time (from Hal::Micros) that the last frame started
+            unsigned long frameStartMicros = 0;
+
+        public:
+            /**
+             * Decode a batch of captured symbols
+             * May be called from an interrupt context
+             *
+             * @param symbols Captured symbols, starting with the first burst after an idle gap
+             */
+            void OnCapture(IrSymbol const * const symbols, size_t const count)
+            {
+                // Signal falls are at the end of each mark, so the interval between
+                // two falls is the space of the earlier symbol plus the mark of the later
+                unsigned long previousSpaceMicros = IDLE_GAP_MICROS;
+                bool frameStarted = false;
+                unsigned long frameStartFallMicros = 0;
+                for (size_t i = 0; i < count; i++)
+                {
+                    signalFallMicros += previousSpaceMicros + symbols[i].MarkMicros;
+                    previousSpaceMicros = symbols[i].SpaceMicros;
+                    // Burst lengths are captured, so the AGC burst itself marks a frame start
+                    if (symbols[i].MarkMicros >= FRAME_START_GAP_MICROS)
+                    {
+                        frameStarted = true;
+                        frameStartFallMicros = signalFallMicros;
+                    }
+                    OnSignalFall(signalFallMicros);
+                }
+                // Batches arrive shortly after their last signal fall, so this
+                // is accurate to the peripheral's idle gap
+                if (frameStarted) frameStartMicros = Hal::Micros() - (signalFallMicros - frameStartFallMicros);
+            }
+
+            unsigned long GetLastFrameStartMicros() const
+            {
+                Hal::DisableInterrupts();
+                auto const lastFrameStartMicros = frameStartMicros;
+                Hal::EnableInterrupts();
+                return lastFrameStartMicros;
+            }
+
+            /**
+             * Waking is up to the platform's capture peripheral, not the decoder
+             */
+            bool PowerDownUntilSignal()
+            {
+                return false;
+            }
+    };
+
+    /**
+     * Emulates a capture peripheral, by encoding a code as it would be captured
+     *
+     * @param outSymbols Must have room for SYMBOLS_PER_CODE symbols
+     * @returns The number of symbols written
+     */
+    size_t EncodeNecCode(unsigned long const code, IrSymbol * const outSymbols)
+    {
+        size_t count = 0;
+        outSymbols[count++] = IrSymbol { AGC_MARK_MICROS, AGC_SPACE_MICROS };
+        for (byte bitIndex = BITS_PER_CODE; bitIndex > 0; bitIndex--)
+        {
+            bool const one = (code >> (bitIndex - 1)) & 1UL;
+            outSymbols[count++] = IrSymbol { BIT_MARK_MICROS, one ? ONE_SPACE_MICROS : ZERO_SPACE_MICROS };
+        }
+        // The stop burst's trailing edge completes the last bit. Its space is the idle gap
+        outSymbols[count++] = IrSymbol { BIT_MARK_MICROS, 0 };
+        return count;
+    }
+
+    /**
+     * Emulates a capture peripheral, by encoding a repeat as it would be captured
+     *
+     * @param outSymbols Must have room for SYMBOLS_PER_REPEAT symbols
+     * @returns The number of symbols written
+     */
+    size_t EncodeNecRepeat(IrSymbol * const outSymbols)
+    {
+        outSymbols[0] = IrSymbol { AGC_MARK_MICROS, REPEAT_SPACE_MICROS };
+        outSymbols[1] = IrSymbol { BIT_MARK_MICROS, 0 };
+        return SYMBOLS_PER_REPEAT;
+    }
+}
+
+#endif //BATCH_IR_RECEIVER_H
\ No newline at end of file
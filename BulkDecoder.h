@@ -0,0 +1,288 @@
+#ifndef BULK_DECODER_H
+#define BULK_DECODER_H
+
+#if defined(ARDUINO)
+#error "BulkDecoder.h is for host builds only. Use DecodePackets from BatchDecoder.h on the MCU"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "BatchDecoder.h"
+
+/**
+ * Offline decoder for bulk capture corpora
+ *
+ * Decodes in two passes over each chunk of intervals:
+ *  1. Classify every interval against the ZERO/ONE/REPEAT/AGC windows,
+ *     using vector compares (AVX2 or SSE2 where available)
+ *  2. Walk the classes, turning each AGC followed by 32 bit classes into
+ *     a code with a single mask extraction, rather than bit by bit
+ *
+ * Only the standard decoding profile is supported: the glitch filter
+ * of the noise-tolerant profile makes each interval depend on the ones
+ * before it, which defeats classifying them independently
+ */
+namespace IrReceiverUtils
+{
+    enum IntervalClass : uint8_t
+    {
+        INTERVAL_ZERO = 0,
+        INTERVAL_ONE = 1,
+        INTERVAL_REPEAT = 2,
+        INTERVAL_AGC = 3,
+        INTERVAL_OTHER = 4
+    };
+
+    namespace BulkDecoderDetail
+    {
+        size_t const CHUNK_INTERVALS = 4096;
+
+        uint32_t const ZERO_LOW = ZERO_DURATION - HALF_WINDOW;
+        uint32_t const ONE_LOW = ONE_DURATION - HALF_WINDOW;
+        uint32_t const REPEAT_LOW = REPEAT_DURATION - HALF_WINDOW;
+        uint32_t const AGC_LOW = AGC_DURATION - HALF_WINDOW;
+        uint32_t const WINDOW_WIDTH = 2 * HALF_WINDOW;
+
+        // The windows do not overlap, so at most one of these terms is non-zero
+        inline uint8_t ClassifyScalar(uint32_t const intervalMicros)
+        {
+            bool const isZero = intervalMicros - ZERO_LOW <= WINDOW_WIDTH;
+            bool const isOne = intervalMicros - ONE_LOW <= WINDOW_WIDTH;
+            bool const isRepeat = intervalMicros - REPEAT_LOW <= WINDOW_WIDTH;
+            bool const isAgc = intervalMicros - AGC_LOW <= WINDOW_WIDTH;
+            bool const isOther = !(isZero | isOne | isRepeat | isAgc);
+            return (isOne * INTERVAL_ONE) | (isRepeat * INTERVAL_REPEAT) | (isAgc * INTERVAL_AGC) | (isOther * INTERVAL_OTHER);
+        }
+
+#if defined(__AVX2__)
+        size_t const VECTOR_INTERVALS = 32;
+
+        // Unsigned (x - low) <= width, via min(x - low, width) == x - low
+        inline __m256i InWindow(__m256i const intervals, uint32_t const low)
+        {
+            __m256i const offset = _mm256_sub_epi32(intervals, _mm256_set1_epi32(low));
+            return _mm256_cmpeq_epi32(_mm256_min_epu32(offset, _mm256_set1_epi32(WINDOW_WIDTH)), offset);
+        }
+
+        // 8 intervals to 8 classes, one per 32 bit lane
+        inline __m256i Classify8(uint32_t const * const intervalsMicros)
+        {
+            __m256i const intervals = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(intervalsMicros));
+            __m256i const isZero = InWindow(intervals, ZERO_LOW);
+            __m256i const isOne = InWindow(intervals, ONE_LOW);
+            __m256i const isRepeat = InWindow(intervals, REPEAT_LOW);
+            __m256i const isAgc = InWindow(intervals, AGC_LOW);
+            __m256i const isAny = _mm256_or_si256(_mm256_or_si256(isZero, isOne), _mm256_or_si256(isRepeat, isAgc));
+            __m256i classes = _mm256_andnot_si256(isAny, _mm256_set1_epi32(INTERVAL_OTHER));
+            classes = _mm256_or_si256(classes, _mm256_and_si256(isOne, _mm256_set1_epi32(INTERVAL_ONE)));
+            classes = _mm256_or_si256(classes, _mm256_and_si256(isRepeat, _mm256_set1_epi32(INTERVAL_REPEAT)));
+            return _mm256_or_si256(classes, _mm256_and_si256(isAgc, _mm256_set1_epi32(INTERVAL_AGC)));
+        }
+
+        inline void ClassifyVector(uint32_t const * const intervalsMicros, uint8_t * const outClasses)
+        {
+            __m256i const ab = _mm256_packs_epi32(Classify8(intervalsMicros), Classify8(intervalsMicros + 8));
+            __m256i const cd = _mm256_packs_epi32(Classify8(intervalsMicros + 16), Classify8(intervalsMicros + 24));
+            // Packing works within each 128 bit lane, so restore the order of the 4 byte groups
+            __m256i const packed = _mm256_packs_epi16(ab, cd);
+            __m256i const ordered = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(outClasses), ordered);
+        }
+
+        /**
+         * @param outValid Bit i is set iff. class i is a ZERO or ONE
+         * @param outOnes Bit i is set iff. class i is a ONE
+         */
+        inline void BitMasks(uint8_t const * const classes, uint32_t & outValid, uint32_t & outOnes)
+        {
+            __m256i const loaded = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(classes));
+            __m256i const isBit = _mm256_cmpgt_epi8(_mm256_set1_epi8(INTERVAL_REPEAT), loaded);
+            __m256i const isOne = _mm256_cmpeq_epi8(loaded, _mm256_set1_epi8(INTERVAL_ONE));
+            outValid = static_cast<uint32_t>(_mm256_movemask_epi8(isBit));
+            outOnes = static_cast<uint32_t>(_mm256_movemask_epi8(isOne));
+        }
+#elif defined(__SSE2__)
+        size_t const VECTOR_INTERVALS = 16;
+
+        // SSE2 has no unsigned compare, so flip the sign bits and compare signed
+        inline __m128i InWindow(__m128i const intervals, uint32_t const low)
+        {
+            __m128i const signBit = _mm_set1_epi32(static_cast<int>(0x80000000U));
+            __m128i const offset = _mm_xor_si128(_mm_sub_epi32(intervals, _mm_set1_epi32(low)), signBit);
+            __m128i const width = _mm_xor_si128(_mm_set1_epi32(WINDOW_WIDTH), signBit);
+            return _mm_xor_si128(_mm_cmpgt_epi32(offset, width), _mm_set1_epi32(-1));
+        }
+
+        inline __m128i Classify4(uint32_t const * const intervalsMicros)
+        {
+            __m128i const intervals = _mm_loadu_si128(reinterpret_cast<__m128i const *>(intervalsMicros));
+            __m128i const isZero = InWindow(intervals, ZERO_LOW);
+            __m128i const isOne = InWindow(intervals, ONE_LOW);
+            __m128i const isRepeat = InWindow(intervals, REPEAT_LOW);
+            __m128i const isAgc = InWindow(intervals, AGC_LOW);
+            __m128i const isAny = _mm_or_si128(_mm_or_si128(isZero, isOne), _mm_or_si128(isRepeat, isAgc));
+            __m128i classes = _mm_andnot_si128(isAny, _mm_set1_epi32(INTERVAL_OTHER));
+            classes = _mm_or_si128(classes, _mm_and_si128(isOne, _mm_set1_epi32(INTERVAL_ONE)));
+            classes = _mm_or_si128(classes, _mm_and_si128(isRepeat, _mm_set1_epi32(INTERVAL_REPEAT)));
+            return _mm_or_si128(classes, _mm_and_si128(isAgc, _mm_set1_epi32(INTERVAL_AGC)));
+        }
+
+        inline void ClassifyVector(uint32_t const * const intervalsMicros, uint8_t * const outClasses)
+        {
+            __m128i const ab = _mm_packs_epi32(Classify4(intervalsMicros), Classify4(intervalsMicros + 4));
+            __m128i const cd = _mm_packs_epi32(Classify4(intervalsMicros + 8), Classify4(intervalsMicros + 12));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(outClasses), _mm_packs_epi16(ab, cd));
+        }
+
+        inline void BitMasks(uint8_t const * const classes, uint32_t & outValid, uint32_t & outOnes)
+        {
+            __m128i const twos = _mm_set1_epi8(INTERVAL_REPEAT);
+            __m128i const ones = _mm_set1_epi8(INTERVAL_ONE);
+            __m128i const low = _mm_loadu_si128(reinterpret_cast<__m128i const *>(classes));
+            __m128i const high = _mm_loadu_si128(reinterpret_cast<__m128i const *>(classes + 16));
+            outValid = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(twos, low)))
+                | static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(twos, high))) << 16;
+            outOnes = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(low, ones)))
+                | static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(high, ones))) << 16;
+        }
+#else
+        size_t const VECTOR_INTERVALS = 1;
+
+        inline void ClassifyVector(uint32_t const * const intervalsMicros, uint8_t * const outClasses)
+        {
+            outClasses[0] = ClassifyScalar(intervalsMicros[0]);
+        }
+
+        inline void BitMasks(uint8_t const * const classes, uint32_t & outValid, uint32_t & outOnes)
+        {
+            outValid = 0;
+            outOnes = 0;
+            for (byte i = 0; i < BITS_PER_CODE; i++)
+            {
+                outValid |= static_cast<uint32_t>(classes[i] <= INTERVAL_ONE) << i;
+                outOnes |= static_cast<uint32_t>(classes[i] == INTERVAL_ONE) << i;
+            }
+        }
+#endif
+
+        // The first interval of a code is its most significant bit,
+        // but it lands in the least significant bit of a mask
+        inline uint32_t ReverseBits(uint32_t value)
+        {
+            value = ((value >> 1) & 0x55555555U) | ((value & 0x55555555U) << 1);
+            value = ((value >> 2) & 0x33333333U) | ((value & 0x33333333U) << 2);
+            value = ((value >> 4) & 0x0F0F0F0FU) | ((value & 0x0F0F0F0FU) << 4);
+            value = ((value >> 8) & 0x00FF00FFU) | ((value & 0x00FF00FFU) << 8);
+            return (value >> 16) | (value << 16);
+        }
+
+        inline unsigned int CountTrailingZeros(uint32_t const value)
+        {
+            return __builtin_ctz(value);
+        }
+
+        /**
+         * Second pass: decode a chunk of classes, carrying state over
+         *
+         * @param decodeCount Number of classes to decode. A code starting
+         * before this point may run past it, up to classCount
+         * @returns The number of classes consumed
+         */
+        inline size_t DecodeClasses(
+            uint8_t const * const classes,
+            size_t const decodeCount,
+            size_t const classCount,
+            IrPacket * const outPackets,
+            size_t const maxPackets,
+            size_t & packetCount,
+            BatchDecodeState & state)
+        {
+            size_t i = 0;
+            while (i < decodeCount && packetCount < maxPackets)
+            {
+                if (state.State == RECEIVING_PACKET)
+                {
+                    // Whole code in one step, if it starts here and all of its classes are available
+                    if (state.BitsCaptured == 0 && classCount - i >= BITS_PER_CODE)
+                    {
+                        uint32_t valid;
+                        uint32_t ones;
+                        BitMasks(classes + i, valid, ones);
+                        state.State = WAITING_FOR_PACKET;
+                        if (valid == 0xFFFFFFFFU)
+                        {
+                            outPackets[packetCount++] = IrPacket { false, ReverseBits(ones) };
+                            i += BITS_PER_CODE;
+                        }
+                        // The first invalid interval aborts the code and is consumed
+                        else i += CountTrailingZeros(~valid) + 1;
+                        continue;
+                    }
+
+                    auto const intervalClass = classes[i++];
+                    if (intervalClass > INTERVAL_ONE) state.State = WAITING_FOR_PACKET;
+                    else
+                    {
+                        state.Code = state.Code * 2 + intervalClass;
+                        if (++state.BitsCaptured == BITS_PER_CODE)
+                        {
+                            outPackets[packetCount++] = IrPacket { false, state.Code };
+                            state.State = WAITING_FOR_PACKET;
+                        }
+                    }
+                    continue;
+                }
+
+                auto const intervalClass = classes[i++];
+                if (intervalClass == INTERVAL_REPEAT) outPackets[packetCount++] = IrPacket { true, 0UL };
+                else if (intervalClass == INTERVAL_AGC)
+                {
+                    state.State = RECEIVING_PACKET;
+                    state.BitsCaptured = 0;
+                    state.Code = 0UL;
+                }
+            }
+            return i;
+        }
+    }
+
+    /**
+     * Decode every packet in a buffer of signal-fall intervals
+     * Produces identical results to DecodePackets (with the standard profile)
+     * for the same inputs and state, including when outPackets fills up
+     */
+    size_t DecodePacketsBulk(
+        uint32_t const * const intervalsMicros,
+        size_t const intervalCount,
+        IrPacket * const outPackets,
+        size_t const maxPackets,
+        BatchDecodeState & state)
+    {
+        using namespace BulkDecoderDetail;
+
+        // Each chunk classifies a whole code's worth of intervals beyond the
+        // ones it decodes, so that codes straddling chunks take the fast path
+        uint8_t classes[CHUNK_INTERVALS + BITS_PER_CODE];
+        size_t packetCount = 0;
+        size_t position = 0;
+        while (position < intervalCount && packetCount < maxPackets)
+        {
+            size_t const remaining = intervalCount - position;
+            size_t const decodeCount = remaining < CHUNK_INTERVALS ? remaining : CHUNK_INTERVALS;
+            size_t const classCount = remaining < CHUNK_INTERVALS + BITS_PER_CODE ? remaining : CHUNK_INTERVALS + BITS_PER_CODE;
+
+            uint32_t const * const chunk = intervalsMicros + position;
+            size_t i = 0;
+            for (; i + VECTOR_INTERVALS <= classCount; i += VECTOR_INTERVALS) ClassifyVector(chunk + i, classes + i);
+            for (; i < classCount; i++) classes[i] = ClassifyScalar(chunk[i]);
+
+            position += DecodeClasses(classes, decodeCount, classCount, outPackets, maxPackets, packetCount, state);
+        }
+        return packetCount;
+    }
+}
+
+#endif //BULK_DECODER_H
\ No newline at end of file
@@ -0,0 +1,300 @@
+#ifndef COMMAND_ARBITER_H
+#define COMMAND_ARBITER_H
+
+#include "Hal.h"
+#include "IrReceiver.h"
+
+namespace CommandArbiterUtils
+{
+    using namespace IrReceiverUtils;
+
+    byte const MAX_COMMAND_SOURCES = 4;
+    // Accepted commands waiting to be read by the motor state machine. The state
+    // machine reads one per tick, so this only needs to absorb sources
+    // delivering at the same time
+    byte const COMMAND_QUEUE_LENGTH = 4;
+    byte const NO_SOURCE = 0xFF;
+
+    /**
+     * A stream of volume commands, other than the IR receiver (e.g. serial,
+     * buttons, or a bus linking several units). Commands are normalised to
+     * NEC packets: a source sends the IR code for a command when it starts,
+     * and repeats every REPEAT_PERIOD_MICROS for as long as it continues,
+     * so the motor state machine handles every source alike
+     */
+    class CommandSource
+    {
+        public:
+            /**
+             * Polled once per motor state machine tick
+             *
+             * @returns True iff. there was a command that had not previously been read
+             */
+            virtual bool TryGetPacket(IrPacket & outPacket) = 0;
+
+            /**
+             * @returns The time (from Hal::Micros) that the source last saw a command
+             * start, whether or not it completed. See IrReceiver::GetLastFrameStartMicros
+             */
+            virtual unsigned long GetLastFrameStartMicros() const = 0;
+    };
+
+    /**
+     * Presents an IR receiver as a command source
+     */
+    class IrCommandSource final : public CommandSource
+    {
+        private:
+            IrReceiver & irReceiver;
+
+        public:
+            IrCommandSource(IrReceiver & irReceiver)
+                : irReceiver(irReceiver)
+            { }
+
+            bool TryGetPacket(IrPacket & outPacket)
+            {
+                return irReceiver.TryGetPacket(outPacket);
+            }
+
+            unsigned long GetLastFrameStartMicros() const
+            {
+                return irReceiver.GetLastFrameStartMicros();
+            }
+    };
+
+    // Button contact bounce is ignored for this long after each change
+    unsigned long const BUTTON_DEBOUNCE_MICROS = 20UL * 1000UL;
+
+    /**
+     * A pair of push buttons, for volume up and down, sent as the given IR codes.
+     * Use external pull resistors, so that a released button reads the opposite
+     * level to a pressed one. Holding both buttons does nothing
+     */
+    template <int UpPin, int DownPin> class ButtonCommandSource final : public CommandSource
+    {
+        private:
+            unsigned long const upCode;
+            unsigned long const downCode;
+            bool const activeLow;
+            unsigned long heldCode = 0; // Code of the held button, or zero if none is held
+            unsigned long changeMicros = 0; // Time of the last debounced change
+            unsigned long lastPacketMicros = 0;
+            unsigned long lastPressedMicros = 0;
+
+            bool isPressed(int const pin) const
+            {
+                return Hal::ReadPin(pin) != activeLow;
+            }
+
+        public:
+            /**
+             * @param activeLow True if the pins read LOW while their button is pressed
+             */
+            ButtonCommandSource(unsigned long const upCode, unsigned long const downCode, bool const activeLow)
+                : upCode(upCode)
+                , downCode(downCode)
+                , activeLow(activeLow)
+            {
+                Hal::ConfigureInput(UpPin);
+                Hal::ConfigureInput(DownPin);
+            }
+
+            bool TryGetPacket(IrPacket & outPacket)
+            {
+                auto const currentMicros = Hal::Micros();
+                bool const up = isPressed(UpPin);
+                bool const down = isPressed(DownPin);
+                unsigned long const code = up == down ? 0 : up ? upCode : downCode;
+                if (code) lastPressedMicros = currentMicros;
+
+                if (code != heldCode && currentMicros - changeMicros >= BUTTON_DEBOUNCE_MICROS)
+                {
+                    heldCode = code;
+                    changeMicros = currentMicros;
+                    if (!code) return false;
+                    lastPacketMicros = currentMicros;
+                    outPacket = IrPacket { false, code };
+                    return true;
+                }
+                if (!heldCode || currentMicros - lastPacketMicros < REPEAT_PERIOD_MICROS) return false;
+                lastPacketMicros += REPEAT_PERIOD_MICROS;
+                outPacket = IrPacket { true, 0 };
+                return true;
+            }
+
+            /**
+             * A held button is as good as a frame start
+             */
+            unsigned long GetLastFrameStartMicros() const
+            {
+                return lastPressedMicros;
+            }
+    };
+
+    /**
+     * Merges the IR receiver and other command sources into a single queue of
+     * commands, for the motor state machine to read as though from a receiver
+     *
+     * Each source has a priority, and a timeout. Once a source sends a command,
+     * it keeps control until it has sent nothing for its timeout, and commands
+     * from lower priority sources are dropped until then. A source with the same
+     * or a higher priority takes over straight away
+     *
+     * A source that takes over part way through a command (i.e. with a repeat)
+     * has the repeat replaced by its last code, so that the motor state machine
+     * sees the new command start
+     *
+     * Sources are polled once per read, and only the arbiter is read by the
+     * motor states, so adding sources does not add to each state's work
+     */
+    class CommandArbiter final : public IrReceiver
+    {
+        private:
+            struct SourceSlot
+            {
+                CommandSource * Source;
+                byte Priority;
+                unsigned long TimeoutMicros;
+                unsigned long LastCode; // Zero until the source sends a code
+            };
+
+            struct QueuedCommand
+            {
+                IrPacket Packet;
+                byte Source;
+            };
+
+            IrReceiver & irReceiver;
+            IrCommandSource irSource;
+            SourceSlot sources[MAX_COMMAND_SOURCES];
+            byte sourceCount = 0;
+
+            QueuedCommand queue[COMMAND_QUEUE_LENGTH];
+            byte queueStart = 0;
+            byte queueCount = 0;
+
+            byte owner = NO_SOURCE; // Source in control, if any
+            unsigned long ownerMicros = 0; // Time that the owner last sent a command
+            byte lastCodeSource = NO_SOURCE; // Source of the last command read
+
+            bool ownerActive(unsigned long const currentMicros) const
+            {
+                return owner != NO_SOURCE && currentMicros - ownerMicros < sources[owner].TimeoutMicros;
+            }
+
+            /**
+             * @returns False if the packet was dropped
+             */
+            bool arbitrate(byte const sourceIndex, IrPacket & packet, unsigned long const currentMicros)
+            {
+                auto & slot = sources[sourceIndex];
+                // Kept even when dropped, so that the source can take over later
+                if (!packet.IsRepeat) slot.LastCode = packet.Code;
+                if (sourceIndex != owner
+                    && ownerActive(currentMicros)
+                    && slot.Priority < sources[owner].Priority) return false;
+
+                if (packet.IsRepeat && sourceIndex != owner)
+                {
+                    if (!slot.LastCode) return false;
+                    packet = IrPacket { false, slot.LastCode };
+                }
+                owner = sourceIndex;
+                ownerMicros = currentMicros;
+                return true;
+            }
+
+            void poll()
+            {
+                auto const currentMicros = Hal::Micros();
+                IrPacket packet;
+                for (byte i = 0; i < sourceCount; i++)
+                {
+                    if (!sources[i].Source->TryGetPacket(packet)) continue;
+                    // Drop the newest when full, since the state machine acts on the
+                    // first command it reads, and later repeats would follow it anyway
+                    if (!arbitrate(i, packet, currentMicros) || queueCount == COMMAND_QUEUE_LENGTH) continue;
+                    queue[(queueStart + queueCount++) % COMMAND_QUEUE_LENGTH] = QueuedCommand { packet, i };
+                }
+            }
+
+        public:
+            /**
+             * @param irReceiver Also used for everything other than reading commands
+             * (sleep, motor noise hints and signal quality)
+             * @param irPriority Priority of the IR receiver. Higher values take precedence
+             * @param irTimeoutMicros Duration that the IR receiver keeps control for after
+             * its last packet. Should be a little longer than REPEAT_PERIOD_MICROS
+             */
+            CommandArbiter(IrReceiver & irReceiver, byte const irPriority, unsigned long const irTimeoutMicros)
+                : irReceiver(irReceiver)
+                , irSource(irReceiver)
+            {
+                AddSource(irSource, irPriority, irTimeoutMicros);
+            }
+
+            /**
+             * @param priority Higher values take precedence
+             * @param timeoutMicros Duration that the source keeps control for after its
+             * last command
+             *
+             * @returns False if MAX_COMMAND_SOURCES sources have already been added
+             */
+            bool AddSource(CommandSource & source, byte const priority, unsigned long const timeoutMicros)
+            {
+                if (sourceCount == MAX_COMMAND_SOURCES) return false;
+                sources[sourceCount++] = SourceSlot { &source, priority, timeoutMicros, 0 };
+                return true;
+            }
+
+            bool TryGetPacket(IrPacket & outPacket)
+            {
+                poll();
+                if (!queueCount) return false;
+                auto const & command = queue[queueStart];
+                queueStart = (queueStart + 1) % COMMAND_QUEUE_LENGTH;
+                queueCount--;
+                outPacket = command.Packet;
+                lastCodeSource = command.Source;
+                return true;
+            }
+
+            /**
+             * @returns The last code sent by the source of the last command read
+             */
+            unsigned long GetLastCode() const
+            {
+                return lastCodeSource == NO_SOURCE ? 0 : sources[lastCodeSource].LastCode;
+            }
+
+            /**
+             * The other sources cannot wake the MCU, so it only sleeps if there are none
+             */
+            bool PowerDownUntilSignal()
+            {
+                if (sourceCount > 1) return false;
+                return irReceiver.PowerDownUntilSignal();
+            }
+
+            void SetMotorActive(bool const motorActive)
+            {
+                irReceiver.SetMotorActive(motorActive);
+            }
+
+            SignalQuality const GetSignalQuality() const
+            {
+                return irReceiver.GetSignalQuality();
+            }
+
+            /**
+             * @returns The last activity of the source of the last command read
+             */
+            unsigned long GetLastFrameStartMicros() const
+            {
+                return sources[lastCodeSource == NO_SOURCE ? 0 : lastCodeSource].Source->GetLastFrameStartMicros();
+            }
+    };
+}
+
+#endif //COMMAND_ARBITER_H
\ No newline at end of file
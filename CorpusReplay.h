@@ -0,0 +1,335 @@
+#ifndef CORPUS_REPLAY_H
+#define CORPUS_REPLAY_H
+
+#if !defined(HAL_HOST)
+#error "CorpusReplay.h runs on the host simulation backend. Define HAL_HOST"
+#endif
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "IrReceiver.h"
+#include "VolumeMotorStateMachine.h"
+
+/**
+ * Replays recorded IR captures through the receiver and motor state
+ * machine on the host simulation backend, and collects metrics
+ *
+ * A capture file holds whitespace separated durations in microseconds,
+ * alternating between mark (carrier present) and space (no carrier),
+ * starting with a mark. Everything from a '#' to the end of its line
+ * is a comment
+ */
+namespace CorpusReplayUtils
+{
+    using namespace IrReceiverUtils;
+    using namespace VolumeMotorUtils;
+
+    // Same wiring as the sketch
+    int const IR_RECV_PIN = 2;
+    int const VOLUME_UP_PIN = 4;
+    int const VOLUME_DOWN_PIN = 3;
+    // Simulated time between calls to loop()
+    unsigned long const LOOP_PERIOD_MICROS = 50UL;
+    // Simulated time after the end of a capture, to let the motor come to rest
+    unsigned long const SETTLE_MICROS = 500UL * 1000UL;
+
+    struct ReplayOptions
+    {
+        // See VolumeMotorConfig
+        byte MaxMissedRepeats = 0;
+    };
+
+    struct ReplayMetrics
+    {
+        unsigned long Captures = 0;
+        unsigned long FailedCaptures = 0;
+        unsigned long long Edges = 0;
+        unsigned long Codes = 0;
+        unsigned long Repeats = 0;
+        // Times the motor started moving from idle
+        unsigned long MotorStarts = 0;
+        // Times the motor started moving again while braking. This is the
+        // stutter caused by missed repeats, described in the README
+        unsigned long Stutters = 0;
+        unsigned long long MovingMicros = 0;
+        unsigned long long BrakingMicros = 0;
+        // Time from the last signal fall in each capture until the motor stopped,
+        // summed over the captures in which it stopped after that fall
+        unsigned long long StopLatencyMicros = 0;
+        unsigned long StopsMeasured = 0;
+
+        void Add(ReplayMetrics const & other)
+        {
+            Captures += other.Captures;
+            FailedCaptures += other.FailedCaptures;
+            Edges += other.Edges;
+            Codes += other.Codes;
+            Repeats += other.Repeats;
+            MotorStarts += other.MotorStarts;
+            Stutters += other.Stutters;
+            MovingMicros += other.MovingMicros;
+            BrakingMicros += other.BrakingMicros;
+            StopLatencyMicros += other.StopLatencyMicros;
+            StopsMeasured += other.StopsMeasured;
+        }
+    };
+
+    /**
+     * Passes packets through to the motor state machine, counting them
+     */
+    class CountingIrReceiver final : public IrReceiver
+    {
+        private:
+            IrReceiver & receiver;
+            ReplayMetrics & metrics;
+
+        public:
+            CountingIrReceiver(IrReceiver & receiver, ReplayMetrics & metrics)
+                : receiver(receiver)
+                , metrics(metrics)
+            { }
+
+            bool TryGetPacket(IrPacket & outPacket)
+            {
+                if (!receiver.TryGetPacket(outPacket)) return false;
+                if (outPacket.IsRepeat) metrics.Repeats++;
+                else metrics.Codes++;
+                return true;
+            }
+
+            unsigned long GetLastCode() const
+            {
+                return receiver.GetLastCode();
+            }
+
+            bool PowerDownUntilSignal()
+            {
+                return receiver.PowerDownUntilSignal();
+            }
+
+            void SetMotorActive(bool const motorActive)
+            {
+                receiver.SetMotorActive(motorActive);
+            }
+
+            SignalQuality const GetSignalQuality() const
+            {
+                return receiver.GetSignalQuality();
+            }
+
+            unsigned long GetLastFrameStartMicros() const
+            {
+                return receiver.GetLastFrameStartMicros();
+            }
+    };
+
+    /**
+     * @returns False if the file could not be read, or holds
+     * anything other than durations and comments
+     */
+    bool LoadCapture(std::string const & path, std::vector<unsigned long> & outDurations)
+    {
+        std::ifstream file(path);
+        if (!file) return false;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            auto const comment = line.find('#');
+            if (comment != std::string::npos) line.erase(comment);
+            size_t position = 0;
+            while (position < line.size())
+            {
+                if (isspace(static_cast<unsigned char>(line[position]))) position++;
+                else
+                {
+                    // strtoul would accept a sign, and negate the duration
+                    if (!isdigit(static_cast<unsigned char>(line[position]))) return false;
+                    char const * const token = line.c_str() + position;
+                    char * end;
+                    errno = 0;
+                    unsigned long const duration = strtoul(token, &end, 10);
+                    if (errno || (*end && !isspace(static_cast<unsigned char>(*end)))) return false;
+                    outDurations.push_back(duration);
+                    position += end - token;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Replay a single capture on the calling thread's simulated hardware
+     */
+    void ReplayCapture(
+        std::vector<unsigned long> const & durations,
+        ReplayOptions const & options,
+        ReplayMetrics & metrics)
+    {
+        Hal::Host::Reset();
+        // Inverted demodulator: the pin idles HIGH and is LOW during a mark
+        Hal::Host::SetInputLevel(IR_RECV_PIN, Hal::PIN_HIGH);
+        InputPinIrReceiver<IR_RECV_PIN> pinReceiver(/*inverted:*/true);
+        CountingIrReceiver receiver(pinReceiver.Attach(), metrics);
+        VolumeMotorStateMachine motorStateMachine(
+            receiver,
+            VolumeMotorConfig
+            {
+                .VolumeUpCode = 0xFFA857,
+                .VolumeDownCode = 0xFFE01F,
+                .VolumeUpPin = VOLUME_UP_PIN,
+                .VolumeDownPin = VOLUME_DOWN_PIN,
+                .BrakeDurationMicros = 100UL * 1000UL,
+                .MovementTimeoutMicros = 120UL * 1000UL,
+                .SoftStartMicros = 0,
+                .SupplySagMillivolts = 0,
+                .IdlePowerDownMicros = 0,
+                .StatusLedPin = Hal::NO_PIN,
+                .MaxMissedRepeats = options.MaxMissedRepeats,
+                .ReversalBrakeMicros = 0,
+                .ReversalDeadTimeMicros = 0,
+                .MotorDeadTimeMicros = 0,
+                .MotorEnablePin = Hal::NO_PIN,
+                .ManualHoldOffMicros = 0
+            });
+
+        bool wasMoving = false;
+        bool wasBraking = false;
+        unsigned long lastSignalFallMicros = 0;
+        unsigned long lastStopMicros = 0;
+        auto const runLoopUntil = [&](unsigned long const endMicros)
+        {
+            while (Hal::Micros() < endMicros)
+            {
+                auto const stepMicros = std::min(LOOP_PERIOD_MICROS, endMicros - Hal::Micros());
+                Hal::Host::AdvanceMicros(stepMicros);
+                motorStateMachine.Tick();
+
+                bool const up = Hal::Host::GetOutputLevel(VOLUME_UP_PIN);
+                bool const down = Hal::Host::GetOutputLevel(VOLUME_DOWN_PIN);
+                bool const braking = up && down;
+                bool const moving = up != down;
+                if (moving && !wasMoving)
+                {
+                    if (wasBraking) metrics.Stutters++;
+                    else metrics.MotorStarts++;
+                }
+                if (wasMoving && !moving) lastStopMicros = Hal::Micros();
+                if (moving) metrics.MovingMicros += stepMicros;
+                if (braking) metrics.BrakingMicros += stepMicros;
+                wasMoving = moving;
+                wasBraking = braking;
+            }
+        };
+
+        bool mark = true;
+        for (auto const duration : durations)
+        {
+            Hal::Host::SetInputLevel(IR_RECV_PIN, mark ? Hal::PIN_LOW : Hal::PIN_HIGH);
+            if (!mark) lastSignalFallMicros = Hal::Micros();
+            metrics.Edges++;
+            runLoopUntil(Hal::Micros() + duration);
+            mark = !mark;
+        }
+        Hal::Host::SetInputLevel(IR_RECV_PIN, Hal::PIN_HIGH);
+        runLoopUntil(Hal::Micros() + SETTLE_MICROS);
+        if (lastStopMicros > lastSignalFallMicros)
+        {
+            metrics.StopLatencyMicros += lastStopMicros - lastSignalFallMicros;
+            metrics.StopsMeasured++;
+        }
+        metrics.Captures++;
+    }
+
+    /**
+     * Replay many captures in parallel
+     *
+     * Captures are dealt out round-robin to one queue per thread. Each thread
+     * works from the front of its own queue, and once that is empty, steals
+     * from the back of the others, so that a few long captures do not leave
+     * the other threads idle. Each thread replays on its own simulated
+     * hardware, receiver and motor state machine
+     *
+     * @param outFailedPaths Receives the paths of captures that could not be read
+     */
+    ReplayMetrics ReplayCorpus(
+        std::vector<std::string> const & paths,
+        unsigned int threadCount,
+        ReplayOptions const & options,
+        std::vector<std::string> & outFailedPaths)
+    {
+        if (threadCount == 0) threadCount = 1;
+
+        struct WorkQueue
+        {
+            std::mutex Mutex;
+            std::deque<size_t> Captures;
+        };
+        std::vector<WorkQueue> queues(threadCount);
+        for (size_t i = 0; i < paths.size(); i++) queues[i % threadCount].Captures.push_back(i);
+
+        auto const takeWork = [&](unsigned int const thread, size_t & outCapture)
+        {
+            {
+                std::lock_guard<std::mutex> lock(queues[thread].Mutex);
+                auto & own = queues[thread].Captures;
+                if (!own.empty())
+                {
+                    outCapture = own.front();
+                    own.pop_front();
+                    return true;
+                }
+            }
+            for (unsigned int offset = 1; offset < threadCount; offset++)
+            {
+                auto & victim = queues[(thread + offset) % threadCount];
+                std::lock_guard<std::mutex> lock(victim.Mutex);
+                if (!victim.Captures.empty())
+                {
+                    outCapture = victim.Captures.back();
+                    victim.Captures.pop_back();
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        ReplayMetrics total;
+        std::mutex resultMutex;
+        std::vector<std::thread> threads;
+        for (unsigned int thread = 0; thread < threadCount; thread++)
+        {
+            threads.emplace_back([&, thread]()
+            {
+                ReplayMetrics metrics;
+                std::vector<std::string> failedPaths;
+                std::vector<unsigned long> durations;
+                size_t capture;
+                while (takeWork(thread, capture))
+                {
+                    durations.clear();
+                    if (LoadCapture(paths[capture], durations)) ReplayCapture(durations, options, metrics);
+                    else
+                    {
+                        metrics.FailedCaptures++;
+                        failedPaths.push_back(paths[capture]);
+                    }
+                }
+                std::lock_guard<std::mutex> lock(resultMutex);
+                total.Add(metrics);
+                outFailedPaths.insert(outFailedPaths.end(), failedPaths.begin(), failedPaths.end());
+            });
+        }
+        for (auto & thread : threads) thread.join();
+        return total;
+    }
+}
+
+#endif //CORPUS_REPLAY_H
\ No newline at end of file
@@ -0,0 +1,141 @@
+#ifndef HAL_H
+#define HAL_H
+
+/**
+ * Hardware abstraction layer
+ *
+ * The state machines only talk to the hardware through the functions in
+ * namespace Hal, which each backend provides as inline functions that
+ * forward to the platform's native API, so that once inlined, the
+ * abstraction should add no call overhead. This has not been confirmed
+ * against the AVR code size or disassembly of a build without the HAL.
+ * Every backend must provide:
+ *
+ * Clock:
+ *   unsigned long Micros()
+ *   void DelayMicros(unsigned int micros)
+ *     Busy-waits. Simulations may advance their clock instead
+ *
+ * GPIO:
+ *   void ConfigureInput(int pin)
+ *   void ConfigureOutput(int pin)
+ *   void WritePin(int pin, bool high)
+ *   void WritePins(int pinA, bool highA, int pinB, bool highB)
+ *     Writes both pins at once where the platform can (on AVR, as a single
+ *     port write when they share a port). Otherwise lowers before raising,
+ *     so that swapping which pin is HIGH never passes through both HIGH
+ *   bool ReadPin(int pin)
+ *   byte ReadPins(int pinA, int pinB)
+ *     Reads both pins at once where the platform can (on AVR, as a single
+ *     port read when they share a port), as (levelA << 1) | levelB
+ *
+ * Interrupts:
+ *   void AttachInterrupt(int pin, void (*handler)(), InterruptTrigger trigger)
+ *   void DetachInterrupt(int pin)
+ *   void DisableInterrupts()
+ *   void EnableInterrupts()
+ *
+ * Pin change interrupts (optional, for pins without an external interrupt):
+ *   void AttachPinChangeInterrupt(int pin, void (*handler)())
+ *   void DetachPinChangeInterrupt(int pin)
+ *     Backends that provide these define HAL_PIN_CHANGE_INTERRUPTS. The
+ *     handler may be shared by other pins (on AVR, all pins of the same
+ *     port), and must check which pin changed itself
+ *
+ * Pulse output (optional, e.g. for servos):
+ *   void StartPulse(int pin, unsigned int micros)
+ *     Raises an output pin, and lowers it from a timer interrupt once the
+ *     pulse width has passed, without blocking. Up to 2ms, one pin at a
+ *     time. Backends that provide it define HAL_PULSE_OUTPUT
+ *
+ * Power:
+ *   void PowerDownUntilInterrupt()
+ *     Must be called with interrupts disabled and a wake interrupt attached.
+ *     Stops peripheral clocks, enables interrupts and sleeps, such that
+ *     an interrupt arriving in between cannot be missed. Restores the
+ *     peripherals before returning
+ *
+ * Timer capture:
+ *   void StartCaptureTimer()
+ *   unsigned int ReadCaptureTimer()
+ *     A free-running 16 bit counter, ticking CAPTURE_TIMER_TICKS_PER_MICRO
+ *     times per microsecond
+ *
+ * Persistent storage:
+ *   uint8_t ReadPersistentByte(unsigned int address)
+ *   void UpdatePersistentByte(unsigned int address, uint8_t value)
+ *
+ * Watchdog:
+ *   void EnableWatchdog(WatchdogTimeout timeout, void (*onTimeout)())
+ *     onTimeout is called from the interrupt context on the first timeout,
+ *     and the MCU is reset on the second. Running onTimeout disarms it, so
+ *     call EnableWatchdog again to re-arm it
+ *   void PetWatchdog()
+ *   void DisableWatchdog()
+ *   bool TakeWatchdogReset()
+ *     True iff. the last reset was caused by the watchdog. Only the first
+ *     call after each reset can return true
+ *
+ * Supply voltage:
+ *   void StartSupplyConversion()
+ *   bool IsSupplyConversionComplete()
+ *   unsigned int ReadSupplyMillivolts()
+ *
+ * Backends must also define HAL_THREAD_LOCAL, which qualifies global
+ * and static state that the hardware would only have one of. It should
+ * be empty on the MCU, and thread_local for simulations that run
+ * several independent instances in parallel
+ *
+ * Backends must also provide the Arduino core's byte type (an unsigned
+ * 8 bit integer) at global scope, which the state machines use throughout.
+ * On Arduino, including the core's Arduino.h does this
+ *
+ * To port to another platform, write a header implementing the above
+ * (see HalHost.h for a minimal example) and define HAL_BACKEND_HEADER
+ * as its quoted file name
+ */
+
+#include <stdint.h>
+
+namespace Hal
+{
+    bool const PIN_HIGH = true;
+    bool const PIN_LOW = false;
+    // For optional pins that are not connected. Pin 0 is a valid pin (RX on most Arduinos)
+    int const NO_PIN = -1;
+
+    enum InterruptTrigger
+    {
+        TRIGGER_RISING,
+        TRIGGER_FALLING,
+        TRIGGER_LOW_LEVEL,
+        TRIGGER_CHANGE
+    };
+
+    // Values match the WDTO_* constants from avr-libc
+    enum WatchdogTimeout
+    {
+        WATCHDOG_15MS,
+        WATCHDOG_30MS,
+        WATCHDOG_60MS,
+        WATCHDOG_120MS,
+        WATCHDOG_250MS,
+        WATCHDOG_500MS,
+        WATCHDOG_1S,
+        WATCHDOG_2S,
+        WATCHDOG_4S,
+        WATCHDOG_8S
+    };
+}
+
+#if defined(HAL_BACKEND_HEADER)
+#include HAL_BACKEND_HEADER
+#elif defined(ARDUINO_ARCH_AVR)
+#include "HalAvr.h"
+#elif defined(HAL_HOST)
+#include "HalHost.h"
+#else
+#error "No HAL backend for this platform. Define HAL_BACKEND_HEADER to provide one"
+#endif
+
+#endif //HAL_H
\ No newline at end of file
@@ -0,0 +1,337 @@
+#ifndef HAL_AVR_H
+#define HAL_AVR_H
+
+#include "Arduino.h"
+#include <avr/eeprom.h>
+#include <avr/power.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+
+#define HAL_THREAD_LOCAL
+
+/**
+ * HAL backend for AVR based Arduinos (e.g. Nano, Uno)
+ *
+ * This header defines the WDT interrupt vector, so it must only be
+ * included from a single translation unit (e.g. the sketch)
+ *
+ * Pin change interrupts are only provided when HAL_PIN_CHANGE_INTERRUPTS
+ * is defined before including this header, since they define the PCINT
+ * vectors, which other libraries (e.g. SoftwareSerial) also define
+ *
+ * Likewise, pulse output is only provided when HAL_PULSE_OUTPUT is defined,
+ * since it uses Timer2, which tone() and analogWrite() on pins 3 and 11 also use
+ */
+namespace Hal
+{
+    // The capture timer is Timer1, prescaled by 8.
+    // Note that this makes Timer1 unavailable for the Servo library and
+    // for analogWrite() on pins 9 and 10 once the capture timer is started
+    unsigned int const CAPTURE_TIMER_TICKS_PER_MICRO = F_CPU / 8UL / 1000000UL;
+
+    inline void (*watchdogTimeoutHandler)() = nullptr;
+    // MCUSR at start-up, saved by DisableWatchdogOnReset. Not zeroed by the C runtime
+    uint8_t resetFlags __attribute__((section(".noinit")));
+
+    inline unsigned long Micros()
+    {
+        return micros();
+    }
+
+    inline void DelayMicros(unsigned int const micros)
+    {
+        delayMicroseconds(micros);
+    }
+
+    inline void ConfigureInput(int const pin)
+    {
+        pinMode(pin, INPUT);
+    }
+
+    inline void ConfigureOutput(int const pin)
+    {
+        pinMode(pin, OUTPUT);
+    }
+
+    inline void WritePin(int const pin, bool const high)
+    {
+        digitalWrite(pin, high ? HIGH : LOW);
+    }
+
+    /**
+     * Pins on the same port are written together, with a single store to the
+     * port's output register, rather than two digitalWrite calls
+     */
+    inline void WritePins(int const pinA, bool const highA, int const pinB, bool const highB)
+    {
+        uint8_t const port = digitalPinToPort(pinA);
+        if (port == NOT_A_PIN || port != digitalPinToPort(pinB))
+        {
+            if (!highA) WritePin(pinA, PIN_LOW);
+            if (!highB) WritePin(pinB, PIN_LOW);
+            if (highA) WritePin(pinA, PIN_HIGH);
+            if (highB) WritePin(pinB, PIN_HIGH);
+            return;
+        }
+        volatile uint8_t * const output = portOutputRegister(port);
+        uint8_t const maskA = digitalPinToBitMask(pinA);
+        uint8_t const maskB = digitalPinToBitMask(pinB);
+        uint8_t const highMask = (highA ? maskA : 0) | (highB ? maskB : 0);
+        uint8_t const status = SREG;
+        // Interrupt handlers may write other pins of the port
+        noInterrupts();
+        *output = (*output & ~(maskA | maskB)) | highMask;
+        SREG = status;
+    }
+
+    inline bool ReadPin(int const pin)
+    {
+        return digitalRead(pin) == HIGH;
+    }
+
+    /**
+     * Pins on the same port are read together, with a single load from the
+     * port's input register, rather than two digitalRead calls
+     */
+    inline byte ReadPins(int const pinA, int const pinB)
+    {
+        uint8_t const port = digitalPinToPort(pinA);
+        if (port == NOT_A_PIN || port != digitalPinToPort(pinB)) return (ReadPin(pinA) << 1) | ReadPin(pinB);
+        uint8_t const levels = *portInputRegister(port);
+        return ((levels & digitalPinToBitMask(pinA)) ? 2 : 0) | ((levels & digitalPinToBitMask(pinB)) ? 1 : 0);
+    }
+
+    inline void AttachInterrupt(int const pin, void (* const handler)(), InterruptTrigger const trigger)
+    {
+        attachInterrupt(
+            digitalPinToInterrupt(pin),
+            handler,
+            trigger == TRIGGER_RISING ? RISING
+                : trigger == TRIGGER_FALLING ? FALLING
+                : trigger == TRIGGER_CHANGE ? CHANGE
+                : LOW);
+    }
+
+    inline void DetachInterrupt(int const pin)
+    {
+        detachInterrupt(digitalPinToInterrupt(pin));
+    }
+
+#if defined(HAL_PIN_CHANGE_INTERRUPTS)
+    // One handler per port, indexed by PCICR bit
+    inline void (*pinChangeHandlers[3])() = { };
+
+    inline void AttachPinChangeInterrupt(int const pin, void (* const handler)())
+    {
+        byte const port = digitalPinToPCICRbit(pin);
+        pinChangeHandlers[port] = handler;
+        *digitalPinToPCMSK(pin) |= bit(digitalPinToPCMSKbit(pin));
+        PCIFR = bit(port); // Discard any change before now
+        PCICR |= bit(port);
+    }
+
+    inline void DetachPinChangeInterrupt(int const pin)
+    {
+        auto const mask = digitalPinToPCMSK(pin);
+        *mask &= ~bit(digitalPinToPCMSKbit(pin));
+        if (!*mask) PCICR &= ~bit(digitalPinToPCICRbit(pin));
+    }
+#endif
+
+#if defined(HAL_PULSE_OUTPUT)
+    // Timer2, prescaled by 128: 8us per tick at 16MHz, so an 8 bit compare reaches 2ms
+    unsigned int const PULSE_TIMER_MICROS_PER_TICK = 128UL * 1000000UL / F_CPU;
+
+    inline volatile uint8_t * pulseOutput = nullptr;
+    inline uint8_t pulseMask = 0;
+
+    inline void StartPulse(int const pin, unsigned int const micros)
+    {
+        unsigned int ticks = micros / PULSE_TIMER_MICROS_PER_TICK;
+        if (ticks < 1) ticks = 1;
+        if (ticks > 256) ticks = 256;
+        uint8_t const status = SREG;
+        noInterrupts();
+        pulseOutput = portOutputRegister(digitalPinToPort(pin));
+        pulseMask = digitalPinToBitMask(pin);
+        TCCR2B = 0;
+        TCCR2A = 0;
+        TCNT2 = 0;
+        // The compare flag is set on the tick after the counter matches
+        OCR2A = ticks - 1;
+        TIFR2 = bit(OCF2A);
+        TIMSK2 = bit(OCIE2A);
+        *pulseOutput |= pulseMask;
+        TCCR2B = bit(CS22) | bit(CS20);
+        SREG = status;
+    }
+#endif
+
+    inline void DisableInterrupts()
+    {
+        noInterrupts();
+    }
+
+    inline void EnableInterrupts()
+    {
+        interrupts();
+    }
+
+    /**
+     * External interrupt pins can only wake the MCU from power-down on a
+     * LOW level. With the 16MHz crystal, the MCU takes 16K clock cycles
+     * (1ms) to start up again
+     */
+    inline void PowerDownUntilInterrupt()
+    {
+        auto const adcControl = ADCSRA;
+        auto const powerReduction = PRR;
+        ADCSRA &= ~bit(ADEN); // The ADC must be disabled before its clock can be stopped
+        power_all_disable();
+
+        set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+        sleep_enable();
+#ifdef sleep_bod_disable
+        sleep_bod_disable();
+#endif
+        // The instruction following interrupts() is always executed before
+        // any pending interrupt is serviced, so a signal that arrived while
+        // going to sleep cannot be missed
+        interrupts();
+        sleep_cpu();
+        sleep_disable();
+
+        PRR = powerReduction;
+        ADCSRA = adcControl;
+    }
+
+    inline void StartCaptureTimer()
+    {
+        TCCR1A = 0;
+        TCCR1B = bit(CS11);
+    }
+
+    inline unsigned int ReadCaptureTimer()
+    {
+        return TCNT1;
+    }
+
+    inline uint8_t ReadPersistentByte(unsigned int const address)
+    {
+        return eeprom_read_byte(reinterpret_cast<uint8_t const *>(address));
+    }
+
+    inline void UpdatePersistentByte(unsigned int const address, uint8_t const value)
+    {
+        eeprom_update_byte(reinterpret_cast<uint8_t *>(address), value);
+    }
+
+    /**
+     * Runs the watchdog in "interrupt and system reset" mode
+     */
+    inline void EnableWatchdog(WatchdogTimeout const timeout, void (* const onTimeout)())
+    {
+        watchdogTimeoutHandler = onTimeout;
+        wdt_enable(timeout);
+        // WDIE can be set without the timed change sequence
+        WDTCSR |= bit(WDIE);
+    }
+
+    /**
+     * Compiles to a single instruction
+     */
+    inline void PetWatchdog()
+    {
+        wdt_reset();
+    }
+
+    inline void DisableWatchdog()
+    {
+        wdt_disable();
+    }
+
+    inline bool TakeWatchdogReset()
+    {
+        bool const watchdogReset = resetFlags & bit(WDRF);
+        resetFlags = 0;
+        return watchdogReset;
+    }
+
+    /**
+     * Measures AVCC against the internal bandgap reference
+     * This assumes exclusive use of the ADC, so analogRead()
+     * must not be used elsewhere in the sketch
+     */
+    inline void StartSupplyConversion()
+    {
+        // Reference: AVCC. Input: internal bandgap
+        ADMUX = bit(REFS0) | bit(MUX3) | bit(MUX2) | bit(MUX1);
+        ADCSRA |= bit(ADSC);
+    }
+
+    inline bool IsSupplyConversionComplete()
+    {
+        return !(ADCSRA & bit(ADSC));
+    }
+
+    // Nominal voltage of the internal bandgap reference. Individual chips
+    // vary by up to 10%, so measure your board's AVCC with a multimeter and
+    // scale this value accordingly if you need accurate absolute readings
+    unsigned long const BANDGAP_MILLIVOLTS = 1100UL;
+
+    inline unsigned int ReadSupplyMillivolts()
+    {
+        unsigned int const reading = ADC;
+        return reading ? BANDGAP_MILLIVOLTS * 1024UL / reading : 0;
+    }
+
+    /**
+     * The watchdog remains enabled (with its shortest timeout) after a
+     * watchdog reset. Without a bootloader to disable it, the MCU would
+     * reset again before reaching setup(), so disable it as early as
+     * possible during start-up. WDE cannot be cleared while WDRF is set,
+     * so MCUSR is cleared too, after saving it for TakeWatchdogReset
+     */
+    void DisableWatchdogOnReset() __attribute__((naked, used, section(".init3")));
+    void DisableWatchdogOnReset()
+    {
+        resetFlags = MCUSR;
+        MCUSR = 0;
+        wdt_disable();
+    }
+}
+
+ISR(WDT_vect)
+{
+    // The hardware clears WDIE when this interrupt runs, so the next
+    // timeout resets the MCU, unless EnableWatchdog re-arms it first
+    if (Hal::watchdogTimeoutHandler) Hal::watchdogTimeoutHandler();
+}
+
+#if defined(HAL_PULSE_OUTPUT)
+ISR(TIMER2_COMPA_vect)
+{
+    *Hal::pulseOutput &= ~Hal::pulseMask;
+    TCCR2B = 0;
+    TIMSK2 = 0;
+}
+#endif
+
+#if defined(HAL_PIN_CHANGE_INTERRUPTS)
+ISR(PCINT0_vect)
+{
+    if (Hal::pinChangeHandlers[0]) Hal::pinChangeHandlers[0]();
+}
+
+ISR(PCINT1_vect)
+{
+    if (Hal::pinChangeHandlers[1]) Hal::pinChangeHandlers[1]();
+}
+
+ISR(PCINT2_vect)
+{
+    if (Hal::pinChangeHandlers[2]) Hal::pinChangeHandlers[2]();
+}
+#endif
+
+#endif //HAL_AVR_H
\ No newline at end of file
@@ -0,0 +1,296 @@
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+#include <stdint.h>
+
+typedef uint8_t byte;
+
+#define HAL_THREAD_LOCAL thread_local
+#if !defined(HAL_PIN_CHANGE_INTERRUPTS)
+#define HAL_PIN_CHANGE_INTERRUPTS
+#endif
+#if !defined(HAL_PULSE_OUTPUT)
+#define HAL_PULSE_OUTPUT
+#endif
+
+/**
+ * HAL backend for running the state machines on a desktop machine
+ *
+ * Simulates the hardware: time only advances when told to, output pin
+ * levels are recorded, and changing an input pin's level runs any
+ * interrupt handler attached to it, as the hardware would. The
+ * functions in Hal::Host drive the simulation
+ *
+ * Each thread simulates its own, independent hardware, so that
+ * simulations can run in parallel
+ */
+namespace Hal
+{
+    unsigned int const CAPTURE_TIMER_TICKS_PER_MICRO = 2;
+
+    namespace Host
+    {
+        int const PIN_COUNT = 32;
+        unsigned int const PERSISTENT_BYTE_COUNT = 1024;
+
+        struct PinState
+        {
+            bool IsOutput = false;
+            bool Level = false;
+            void (*Handler)() = nullptr;
+            InterruptTrigger Trigger = TRIGGER_RISING;
+        };
+
+        inline HAL_THREAD_LOCAL unsigned long currentMicros = 0;
+        inline HAL_THREAD_LOCAL PinState pins[PIN_COUNT];
+        inline HAL_THREAD_LOCAL bool interruptsEnabled = true;
+        // Stored inverted, so that the zero-initialised array reads as erased (0xFF)
+        inline HAL_THREAD_LOCAL uint8_t invertedPersistentBytes[PERSISTENT_BYTE_COUNT];
+        // Nominal watchdog timeouts, indexed by WatchdogTimeout
+        unsigned long const WATCHDOG_TIMEOUT_MILLIS[] = { 16, 32, 64, 125, 250, 500, 1000, 2000, 4000, 8000 };
+
+        inline HAL_THREAD_LOCAL bool watchdogEnabled = false;
+        inline HAL_THREAD_LOCAL unsigned long watchdogTimeoutMicros = 0;
+        // Cleared when it runs, as the hardware clears WDIE, until EnableWatchdog re-arms it
+        inline HAL_THREAD_LOCAL void (*watchdogTimeoutHandler)() = nullptr;
+        inline HAL_THREAD_LOCAL unsigned long watchdogPetMicros = 0;
+        inline HAL_THREAD_LOCAL bool watchdogReset = false; // Whether the simulated MCU was last reset by the watchdog
+        inline HAL_THREAD_LOCAL unsigned long watchdogResetCount = 0;
+        inline HAL_THREAD_LOCAL unsigned int supplyMillivolts = 5000;
+        inline HAL_THREAD_LOCAL unsigned long powerDownCount = 0;
+        inline HAL_THREAD_LOCAL int pulsePin = -1; // Pin of the pulse in progress, if any
+        inline HAL_THREAD_LOCAL unsigned long pulseEndMicros = 0;
+
+        /**
+         * Set all simulated hardware back to its power-on state
+         */
+        inline void Reset()
+        {
+            currentMicros = 0;
+            for (auto & pin : pins) pin = PinState();
+            interruptsEnabled = true;
+            for (auto & invertedByte : invertedPersistentBytes) invertedByte = 0;
+            watchdogEnabled = false;
+            watchdogTimeoutMicros = 0;
+            watchdogTimeoutHandler = nullptr;
+            watchdogPetMicros = 0;
+            watchdogReset = false;
+            watchdogResetCount = 0;
+            supplyMillivolts = 5000;
+            powerDownCount = 0;
+            pulsePin = -1;
+            pulseEndMicros = 0;
+        }
+
+        /**
+         * Ends any pulse whose width has passed, as its timer interrupt would,
+         * and times out the watchdog if it has not been pet. The first timeout
+         * runs its handler, and the second resets the simulated MCU, which only
+         * disables the watchdog and counts the reset (the program carries on)
+         */
+        inline void AdvanceMicros(unsigned long const deltaMicros)
+        {
+            currentMicros += deltaMicros;
+            if (pulsePin >= 0 && static_cast<long>(currentMicros - pulseEndMicros) >= 0)
+            {
+                pins[pulsePin].Level = false;
+                pulsePin = -1;
+            }
+            while (watchdogEnabled && currentMicros - watchdogPetMicros >= watchdogTimeoutMicros)
+            {
+                watchdogPetMicros += watchdogTimeoutMicros;
+                if (watchdogTimeoutHandler)
+                {
+                    auto const handler = watchdogTimeoutHandler;
+                    watchdogTimeoutHandler = nullptr;
+                    handler();
+                }
+                else
+                {
+                    watchdogEnabled = false;
+                    watchdogReset = true;
+                    watchdogResetCount++;
+                }
+            }
+        }
+
+        /**
+         * Drive an input pin, running its interrupt handler if the change
+         * matches the attached trigger
+         */
+        inline void SetInputLevel(int const pin, bool const high)
+        {
+            auto & state = pins[pin];
+            bool const rose = high && !state.Level;
+            bool const fell = !high && state.Level;
+            state.Level = high;
+            if (!state.Handler || !interruptsEnabled) return;
+            if ((state.Trigger == TRIGGER_RISING && rose)
+                || (state.Trigger == TRIGGER_FALLING && fell)
+                || (state.Trigger == TRIGGER_LOW_LEVEL && !high)
+                || (state.Trigger == TRIGGER_CHANGE && (rose || fell)))
+            {
+                state.Handler();
+            }
+        }
+
+        inline bool GetOutputLevel(int const pin)
+        {
+            return pins[pin].Level;
+        }
+    }
+
+    inline unsigned long Micros()
+    {
+        return Host::currentMicros;
+    }
+
+    inline void DelayMicros(unsigned int const micros)
+    {
+        Host::AdvanceMicros(micros);
+    }
+
+    inline void ConfigureInput(int const pin)
+    {
+        Host::pins[pin].IsOutput = false;
+    }
+
+    inline void ConfigureOutput(int const pin)
+    {
+        Host::pins[pin].IsOutput = true;
+    }
+
+    inline void WritePin(int const pin, bool const high)
+    {
+        Host::pins[pin].Level = high;
+    }
+
+    inline void WritePins(int const pinA, bool const highA, int const pinB, bool const highB)
+    {
+        if (!highA) WritePin(pinA, PIN_LOW);
+        if (!highB) WritePin(pinB, PIN_LOW);
+        if (highA) WritePin(pinA, PIN_HIGH);
+        if (highB) WritePin(pinB, PIN_HIGH);
+    }
+
+    inline bool ReadPin(int const pin)
+    {
+        return Host::pins[pin].Level;
+    }
+
+    inline byte ReadPins(int const pinA, int const pinB)
+    {
+        return (ReadPin(pinA) << 1) | ReadPin(pinB);
+    }
+
+    /**
+     * The pulse ends once the clock is advanced past its width
+     */
+    inline void StartPulse(int const pin, unsigned int const micros)
+    {
+        Host::pins[pin].Level = true;
+        Host::pulsePin = pin;
+        Host::pulseEndMicros = Host::currentMicros + micros;
+    }
+
+    inline void AttachInterrupt(int const pin, void (* const handler)(), InterruptTrigger const trigger)
+    {
+        Host::pins[pin].Handler = handler;
+        Host::pins[pin].Trigger = trigger;
+    }
+
+    inline void DetachInterrupt(int const pin)
+    {
+        Host::pins[pin].Handler = nullptr;
+    }
+
+    /**
+     * Unlike AVR, each pin has its own handler
+     */
+    inline void AttachPinChangeInterrupt(int const pin, void (* const handler)())
+    {
+        AttachInterrupt(pin, handler, TRIGGER_CHANGE);
+    }
+
+    inline void DetachPinChangeInterrupt(int const pin)
+    {
+        DetachInterrupt(pin);
+    }
+
+    inline void DisableInterrupts()
+    {
+        Host::interruptsEnabled = false;
+    }
+
+    inline void EnableInterrupts()
+    {
+        Host::interruptsEnabled = true;
+    }
+
+    /**
+     * The simulation has no way to block until an input changes,
+     * so this returns immediately, as though woken straight away
+     */
+    inline void PowerDownUntilInterrupt()
+    {
+        Host::powerDownCount++;
+        Host::interruptsEnabled = true;
+    }
+
+    inline void StartCaptureTimer() { }
+
+    inline unsigned int ReadCaptureTimer()
+    {
+        return static_cast<uint16_t>(Host::currentMicros * CAPTURE_TIMER_TICKS_PER_MICRO);
+    }
+
+    inline uint8_t ReadPersistentByte(unsigned int const address)
+    {
+        return ~Host::invertedPersistentBytes[address];
+    }
+
+    inline void UpdatePersistentByte(unsigned int const address, uint8_t const value)
+    {
+        Host::invertedPersistentBytes[address] = ~value;
+    }
+
+    inline void EnableWatchdog(WatchdogTimeout const timeout, void (* const onTimeout)())
+    {
+        Host::watchdogEnabled = true;
+        Host::watchdogTimeoutMicros = Host::WATCHDOG_TIMEOUT_MILLIS[timeout] * 1000UL;
+        Host::watchdogTimeoutHandler = onTimeout;
+        Host::watchdogPetMicros = Host::currentMicros;
+    }
+
+    inline void PetWatchdog()
+    {
+        Host::watchdogPetMicros = Host::currentMicros;
+    }
+
+    inline void DisableWatchdog()
+    {
+        Host::watchdogEnabled = false;
+        Host::watchdogTimeoutHandler = nullptr;
+    }
+
+    inline bool TakeWatchdogReset()
+    {
+        bool const watchdogReset = Host::watchdogReset;
+        Host::watchdogReset = false;
+        return watchdogReset;
+    }
+
+    inline void StartSupplyConversion() { }
+
+    inline bool IsSupplyConversionComplete()
+    {
+        return true;
+    }
+
+    inline unsigned int ReadSupplyMillivolts()
+    {
+        return Host::supplyMillivolts;
+    }
+}
+
+#endif //HAL_HOST_H
\ No newline at end of file
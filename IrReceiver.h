@@ -1,12 +1,14 @@
 #ifndef IR_RECEIVER_H
 #define IR_RECEIVER_H
 
-#include "Arduino.h"
+#include "Hal.h"
 #include "StateMachine.h"
+#include "SignalQuality.h"
 
 namespace IrReceiverUtils
 {
     using namespace StateMachineUtils;
+    using namespace SignalQualityUtils;
 
     enum ReceiverStateId
     {
@@ -35,30 +37,182 @@ namespace IrReceiverUtils
     unsigned long const HALF_WINDOW = 80UL;
     byte const BITS_PER_CODE = 32;
 
-    bool const WithinWindow(unsigned long const testDuration, unsigned long const windowCentre)
+    // Noise-tolerant decoding profile, used while the motor is running
+    // Repeats are what keep the motor moving, so their window is widened
+    // to catch repeats with jittery timing. The AGC window is narrowed
+    // so that noise is less likely to be mistaken for the start of a code
+    // Motor noise can fall a repeat (or AGC) interval apart, and would then keep
+    // the motor running after the button is released. But a frame's first signal
+    // fall ends its 9ms AGC burst, a gap that noise does not leave, so the noisy
+    // profile only accepts repeats and codes timed from a fall that ended a
+    // frame-start gap (see FRAME_START_GAP_MICROS)
+    // CaptureRateBenchmark compares what each profile captures: under noise the
+    // noisy profile captures more repeats and codes, but the narrow AGC window
+    // loses more codes to timing jitter
+    unsigned long const NOISY_REPEAT_HALF_WINDOW = 160UL;
+    unsigned long const NOISY_AGC_HALF_WINDOW = 40UL;
+    // Edges arriving sooner than this after the last accepted edge cannot
+    // be part of a valid packet. While the motor is running, such edges are
+    // treated as glitches and ignored, rather than aborting the packet
+    unsigned long const GLITCH_FILTER_MICROS = ZERO_DURATION - HALF_WINDOW;
+    // Every NEC frame starts with a 9ms AGC burst, during which the signal
+    // cannot fall, so a frame's first signal fall follows a gap at least this
+    // long. Motor noise arrives far more often, so it cannot fake a frame start
+    unsigned long const FRAME_START_GAP_MICROS = 8000UL;
+
+    // Intervals between signal falls, as the receiver's states measure them.
+    // Every interval that can be accepted (at most AGC_DURATION plus its
+    // window) fits in 16 bits, which on AVR is a single register pair,
+    // so longer intervals (e.g. idle gaps) saturate instead
+    typedef uint16_t DecodeMicros;
+
+    /**
+     * @tparam TMicros The type of the duration, which the window is compared in
+     */
+    template <class TMicros> bool WithinWindow(
+        TMicros const testDuration,
+        unsigned long const windowCentre,
+        unsigned long const halfWindow = HALF_WINDOW)
+    {
+        return testDuration >= static_cast<TMicros>(windowCentre - halfWindow)
+            && testDuration <= static_cast<TMicros>(windowCentre + halfWindow);
+    }
+
+    /**
+     * @returns How far testDuration is from nominalDuration, in the type of testDuration
+     */
+    template <class TMicros> TMicros Deviation(TMicros const testDuration, unsigned long const nominalDuration)
     {
-        return testDuration >= (windowCentre - HALF_WINDOW) && testDuration <= (windowCentre + HALF_WINDOW);
+        TMicros const nominal = static_cast<TMicros>(nominalDuration);
+        return testDuration > nominal ? testDuration - nominal : nominal - testDuration;
     }
 
-    class WaitingForPacketState : public State<ReceiverStateId>
+#ifdef IR_TIMING_HISTOGRAMS
+    /**
+     * Symbols whose timing is recorded in the timing histograms
+     */
+    enum TimingSymbol
+    {
+        TIMING_ZERO,
+        TIMING_ONE,
+        TIMING_REPEAT,
+        TIMING_AGC,
+        TIMING_SYMBOL_COUNT
+    };
+
+    // Each bin covers 16us, from 128us shorter than the symbol's nominal duration
+    // Bin 0 also counts every interval more than 112us shorter, and the last bin
+    // every interval 112us or more longer. With the default HALF_WINDOW, accepted
+    // intervals are 48us to 208us past the start of bin 0, so fall in bins 3 to 13
+    // (the noisy profile's repeat window also reaches bins 0 and 15)
+    byte const TIMING_HISTOGRAM_BINS = 16;
+    unsigned long const TIMING_BIN_MICROS = 16UL;
+
+    /**
+     * Counts of how far each accepted interval was from its symbol's
+     * nominal duration. Counters saturate at 255
+     *
+     * Compiled in when IR_TIMING_HISTOGRAMS is defined before including
+     * this header. Recording costs a few cycles per signal fall
+     */
+    class TimingHistograms
+    {
+        private:
+            volatile byte counts[TIMING_SYMBOL_COUNT][TIMING_HISTOGRAM_BINS] = { };
+
+            static DecodeMicros nominalDuration(TimingSymbol const symbol)
+            {
+                switch (symbol)
+                {
+                    case TIMING_ZERO: return ZERO_DURATION;
+                    case TIMING_ONE: return ONE_DURATION;
+                    case TIMING_REPEAT: return REPEAT_DURATION;
+                    case TIMING_AGC:
+                    default:
+                        return AGC_DURATION;
+                }
+            }
+
+        public:
+            /**
+             * @param deltaMicros An accepted interval, so it fits in DecodeMicros
+             */
+            void Record(TimingSymbol const symbol, DecodeMicros const deltaMicros)
+            {
+                DecodeMicros const lowestMicros = nominalDuration(symbol) - TIMING_HISTOGRAM_BINS / 2 * TIMING_BIN_MICROS;
+                DecodeMicros const offsetMicros = deltaMicros < lowestMicros ? 0 : deltaMicros - lowestMicros;
+                byte const bin = offsetMicros >= TIMING_HISTOGRAM_BINS * TIMING_BIN_MICROS
+                    ? TIMING_HISTOGRAM_BINS - 1
+                    : offsetMicros / TIMING_BIN_MICROS;
+                if (counts[symbol][bin] != 255) counts[symbol][bin]++;
+            }
+
+            /**
+             * Bins are read one at a time while the receiver may still be
+             * recording, so a copy taken during a packet may be off by one
+             */
+            void Read(TimingSymbol const symbol, byte (& outCounts)[TIMING_HISTOGRAM_BINS]) const
+            {
+                for (byte bin = 0; bin < TIMING_HISTOGRAM_BINS; bin++) outCounts[bin] = counts[symbol][bin];
+            }
+
+            void Clear()
+            {
+                for (byte symbol = 0; symbol < TIMING_SYMBOL_COUNT; symbol++)
+                {
+                    for (byte bin = 0; bin < TIMING_HISTOGRAM_BINS; bin++) counts[symbol][bin] = 0;
+                }
+            }
+    };
+#endif
+
+    template <class TDeltaMicros> class WaitingForPacketState final : public State<ReceiverStateId, TDeltaMicros>
     {
         private:
             volatile IrPacket & packet;
+            volatile bool const & noisy;
+            bool const & afterFrameStartGap; // Whether the last signal fall ended a frame-start gap
+#ifdef IR_TIMING_HISTOGRAMS
+            TimingHistograms & histograms;
+#endif
 
         public:
-            WaitingForPacketState(volatile IrPacket & packet)
+#ifdef IR_TIMING_HISTOGRAMS
+            WaitingForPacketState(
+                volatile IrPacket & packet,
+                volatile bool const & noisy,
+                bool const & afterFrameStartGap,
+                TimingHistograms & histograms)
+                : packet(packet)
+                , noisy(noisy)
+                , afterFrameStartGap(afterFrameStartGap)
+                , histograms(histograms)
+            { }
+#else
+            WaitingForPacketState(volatile IrPacket & packet, volatile bool const & noisy, bool const & afterFrameStartGap)
                 : packet(packet)
+                , noisy(noisy)
+                , afterFrameStartGap(afterFrameStartGap)
             { }
+#endif
 
-            ReceiverStateId const Tick(unsigned long const deltaMicros)
+            ReceiverStateId Tick(TDeltaMicros const deltaMicros)
             {
-                if(WithinWindow(deltaMicros, REPEAT_DURATION))
+                // Timed from motor noise, rather than from the end of an AGC burst
+                if(noisy && !afterFrameStartGap) return WAITING_FOR_PACKET;
+                if(WithinWindow(deltaMicros, REPEAT_DURATION, noisy ? NOISY_REPEAT_HALF_WINDOW : HALF_WINDOW))
                 {
+#ifdef IR_TIMING_HISTOGRAMS
+                    histograms.Record(TIMING_REPEAT, deltaMicros);
+#endif
                     packet.IsRepeat = true;
                     return RECEIVED_PACKET;
                 }
-                else if(WithinWindow(deltaMicros, AGC_DURATION))
+                else if(WithinWindow(deltaMicros, AGC_DURATION, noisy ? NOISY_AGC_HALF_WINDOW : HALF_WINDOW))
                 {
+#ifdef IR_TIMING_HISTOGRAMS
+                    histograms.Record(TIMING_AGC, deltaMicros);
+#endif
                     return RECEIVING_PACKET;
                 }
                 else return WAITING_FOR_PACKET;
@@ -67,32 +221,57 @@ namespace IrReceiverUtils
             void OnEnterState() { }
     };
 
-    class ReceivingPacketState : public State<ReceiverStateId>
+    template <class TDeltaMicros> class ReceivingPacketState final : public State<ReceiverStateId, TDeltaMicros>
     {
         private:
             volatile IrPacket & packet;
+            SignalQualityMonitor & signalQuality;
             byte bitsCaptured = 0;
+#ifdef IR_TIMING_HISTOGRAMS
+            TimingHistograms & histograms;
+#endif
 
         public:
-            ReceivingPacketState(volatile IrPacket & packet)
+#ifdef IR_TIMING_HISTOGRAMS
+            ReceivingPacketState(
+                volatile IrPacket & packet,
+                SignalQualityMonitor & signalQuality,
+                TimingHistograms & histograms)
+                : packet(packet)
+                , signalQuality(signalQuality)
+                , histograms(histograms)
+            { }
+#else
+            ReceivingPacketState(volatile IrPacket & packet, SignalQualityMonitor & signalQuality)
                 : packet(packet)
+                , signalQuality(signalQuality)
             { }
+#endif
 
-            ReceiverStateId const Tick(unsigned long const deltaMicros)
+            ReceiverStateId Tick(TDeltaMicros const deltaMicros)
             {
                 if (WithinWindow(deltaMicros, ZERO_DURATION))
                 {
+#ifdef IR_TIMING_HISTOGRAMS
+                    histograms.Record(TIMING_ZERO, deltaMicros);
+#endif
+                    signalQuality.RecordBit(Deviation(deltaMicros, ZERO_DURATION));
                     packet.Code *= 2;
                     return (++bitsCaptured == BITS_PER_CODE) ? RECEIVED_PACKET : RECEIVING_PACKET;
                 }
                 else if (WithinWindow(deltaMicros, ONE_DURATION))
                 {
+#ifdef IR_TIMING_HISTOGRAMS
+                    histograms.Record(TIMING_ONE, deltaMicros);
+#endif
+                    signalQuality.RecordBit(Deviation(deltaMicros, ONE_DURATION));
                     packet.Code *= 2;
                     packet.Code++;
                     return (++bitsCaptured == BITS_PER_CODE) ? RECEIVED_PACKET : RECEIVING_PACKET; 
                 }
                 else
                 {
+                    signalQuality.RecordInvalidFrame();
                     return WAITING_FOR_PACKET;
                 }
             }
@@ -105,31 +284,38 @@ namespace IrReceiverUtils
             }
     };
 
-    class ReceivedPacketState : public State<ReceiverStateId>
+    template <class TDeltaMicros> class ReceivedPacketState final : public State<ReceiverStateId, TDeltaMicros>
     {
         private:
             volatile IrPacket const & packet;
             volatile unsigned long & lastCode;
             volatile bool & packetReady;
+            SignalQualityMonitor & signalQuality;
 
         public:
             ReceivedPacketState(
                 volatile IrPacket const & packet,
                 volatile unsigned long & lastCode,
-                volatile bool & packetReady)
+                volatile bool & packetReady,
+                SignalQualityMonitor & signalQuality)
                 : packet(packet)
                 , lastCode(lastCode)
                 , packetReady(packetReady)
+                , signalQuality(signalQuality)
             { }
 
-            ReceiverStateId const Tick(unsigned long const)
+            ReceiverStateId Tick(TDeltaMicros const)
             {
                 return RECEIVED_PACKET;
             }
 
             void OnEnterState()
             {
-                if(!packet.IsRepeat) lastCode = packet.Code;
+                if(!packet.IsRepeat)
+                {
+                    lastCode = packet.Code;
+                    signalQuality.RecordValidCode();
+                }
                 packetReady = true;
             }
     };
@@ -159,25 +345,58 @@ namespace IrReceiverUtils
              * @returns The last code (non-repeat packet) captured by the receiver
              * Returned value is not valid until at least one packet has been captured
              */
-            virtual volatile unsigned long GetLastCode() const = 0;
+            virtual unsigned long GetLastCode() const = 0;
+
+            /**
+             * Put the MCU into power-down sleep until the receiver detects an IR signal
+             * Peripheral clocks (ADC, timers, etc.) are stopped while asleep,
+             * so micros() does not advance during sleep
+             *
+             * @returns True iff. the MCU was put to sleep. If false is
+             * returned, the receiver is unable to wake the MCU and no
+             * sleep occurred
+             */
+            virtual bool PowerDownUntilSignal() = 0;
+
+            /**
+             * Hint that the motor is (or is no longer) running
+             * Brushed motors emit electrical noise that couples into the
+             * receiver input, so while the motor is running, the receiver
+             * switches to a more noise-tolerant decoding profile
+             */
+            virtual void SetMotorActive(bool const motorActive) = 0;
+
+            /**
+             * @returns The receiver's recent signal quality, for diagnosing
+             * poor quality demodulators and interference
+             */
+            virtual SignalQuality const GetSignalQuality() const = 0;
+
+            /**
+             * @returns The time (from Hal::Micros) that the last frame started
+             * (see FRAME_START_GAP_MICROS), whether or not it completed a packet
+             */
+            virtual unsigned long GetLastFrameStartMicros() const = 0;
     };
 
     /**
-     * IR Receiver for NEC protocol IR data transmission
-     * Attach to an interrupt capable digital input pin
-     * which has a 38kHz IR demodulator (e.g. TSOP1838) connected
+     * Decodes NEC protocol packets from the intervals between signal falls
+     * Implements everything except for how the signal falls are captured,
+     * which is left to subclasses
      *
      * This class does NOT buffer packets. Once a data packet has
      * arrived, the receiver will ignore subsequent packets until
      * one of the TryGetPacket overloads reads the packet
+     *
+     * @tparam TClock The clock policy that signal falls are timed with (see StateMachine.h)
+     * @tparam TDeltaMicros The type that intervals are decoded in. unsigned long
+     * gives the 32 bit decode path, for comparison (see DecodeCycleBenchmark)
      */
-    template <int ReceiverPin> class InputPinIrReceiver :
-        private StateMachine<ReceiverStateId>,
+    template <class TClock = MicrosClock, class TDeltaMicros = DecodeMicros> class IrPacketDecoder :
+        protected StateMachine<ReceiverStateId, TClock, TDeltaMicros>,
         public IrReceiver
     {
-        private:
-            inline static InputPinIrReceiver<ReceiverPin> instance;
-
+        protected:
             // These variables are written to inside the interrupt context,
             // but can be read from the main program thread. Therefore,
             // they must be marked volatile, so that the compiler does
@@ -185,25 +404,51 @@ namespace IrReceiverUtils
             volatile IrPacket packet;
             volatile unsigned long lastCode;
             volatile bool packetReady = false;
+            // Written from the main thread, read inside the interrupt context
+            volatile bool motorActive = false;
+            // Only accessed inside the interrupt context
+            bool afterFrameStartGap = false;
+            SignalQualityMonitor signalQuality;
+#ifdef IR_TIMING_HISTOGRAMS
+            TimingHistograms timingHistograms;
+#endif
 
-            WaitingForPacketState waitingForPacketState;
-            ReceivingPacketState receivingPacketState;
-            ReceivedPacketState receivedPacketState;
+            WaitingForPacketState<TDeltaMicros> waitingForPacketState;
+            ReceivingPacketState<TDeltaMicros> receivingPacketState;
+            ReceivedPacketState<TDeltaMicros> receivedPacketState;
 
-            static void handleSignalFall()
+            IrPacketDecoder()
+                : StateMachine<ReceiverStateId, TClock, TDeltaMicros>(WAITING_FOR_PACKET, &waitingForPacketState)
+#ifdef IR_TIMING_HISTOGRAMS
+                , waitingForPacketState(packet, motorActive, afterFrameStartGap, timingHistograms)
+                , receivingPacketState(packet, signalQuality, timingHistograms)
+#else
+                , waitingForPacketState(packet, motorActive, afterFrameStartGap)
+                , receivingPacketState(packet, signalQuality)
+#endif
+                , receivedPacketState(packet, lastCode, packetReady, signalQuality)
+            { }
+
+            /**
+             * Decode a signal fall, as the receiver's interrupt does. While the motor is
+             * active, signal falls too soon after the last accepted one are ignored as
+             * glitches. Every decoder ticks its states through here, as do the
+             * benchmarks' reference decoders, so that they all decode alike
+             *
+             * @returns True iff. the signal fall was accepted, and ended a frame-start
+             * gap (see FRAME_START_GAP_MICROS)
+             */
+            bool OnSignalFall(typename TClock::Time const currentTime)
             {
-                instance.Tick();
+                auto const deltaMicros = this->GetMicrosSinceLastTick(currentTime);
+                if (motorActive && deltaMicros < GLITCH_FILTER_MICROS) return false;
+                bool const frameStartGap = deltaMicros >= FRAME_START_GAP_MICROS;
+                this->Tick(currentTime, deltaMicros);
+                afterFrameStartGap = frameStartGap;
+                return frameStartGap;
             }
 
-            InputPinIrReceiver()
-                : StateMachine(WAITING_FOR_PACKET, &waitingForPacketState)
-                , waitingForPacketState(packet)
-                , receivingPacketState(packet)
-                , receivedPacketState(packet, lastCode, packetReady)
-            { }
-
-        protected:
-            State<ReceiverStateId> * GetStateInstance(ReceiverStateId const stateIdentifier) const
+            State<ReceiverStateId, TDeltaMicros> * GetStateInstance(ReceiverStateId const stateIdentifier)
             {
                 switch(stateIdentifier)
                 {
@@ -215,48 +460,185 @@ namespace IrReceiverUtils
                 }
             }
 
+        public:
+            bool TryGetPacket(IrPacket & outPacket)
+            {
+                if (packetReady)
+                {
+                    outPacket.Code = packet.Code;
+                    outPacket.IsRepeat = packet.IsRepeat;
+                    this->SetState(WAITING_FOR_PACKET);
+                    packetReady = false;
+                    signalQuality.RecordPacketRead(outPacket.IsRepeat, Hal::Micros());
+                    return true;
+                }
+                else return false;
+            }
+
+            unsigned long GetLastCode() const
+            {
+                return lastCode;
+            }
+
+            void SetMotorActive(bool const active)
+            {
+                motorActive = active;
+            }
+
+            SignalQuality const GetSignalQuality() const
+            {
+                return signalQuality.GetSignalQuality(HALF_WINDOW);
+            }
+
+#ifdef IR_TIMING_HISTOGRAMS
+            /**
+             * Timing margin of the intervals this receiver has accepted.
+             * See TimingHistograms
+             */
+            TimingHistograms & GetTimingHistograms()
+            {
+                return timingHistograms;
+            }
+#endif
+    };
+
+    // The receiver attached to each pin's interrupt, whatever its clock
+    template <int ReceiverPin> inline HAL_THREAD_LOCAL IrReceiver const * pinReceiver = nullptr;
+
+    /**
+     * IR Receiver for NEC protocol IR data transmission
+     * Attach to an interrupt capable digital input pin
+     * which has a 38kHz IR demodulator (e.g. TSOP1838) connected
+     *
+     * Any number of receivers can be constructed for a pin, but only one
+     * can be attached to the pin's interrupt at a time
+     *
+     * @tparam TClock MicrosClock, or CaptureTimerClock for finer timing
+     * (which must then be attached from setup(), see CaptureTimerClock)
+     */
+    template <int ReceiverPin, class TClock = MicrosClock> class InputPinIrReceiver final : public IrPacketDecoder<TClock>
+    {
+        private:
+            // Interrupt handlers are plain functions, so each pin has a trampoline
+            // that forwards to the receiver currently attached to it. This costs one
+            // pointer load per edge over calling a static receiver directly
+            // One per pin and clock on the MCU. One per pin and clock per thread in host
+            // simulations. Only valid while pinReceiver says that it owns the pin
+            inline static HAL_THREAD_LOCAL InputPinIrReceiver<ReceiverPin, TClock> * attached = nullptr;
+
+            bool isAttached() const
+            {
+                return pinReceiver<ReceiverPin> == this;
+            }
+
+            bool const inverted;
+            // Written inside the interrupt context
+            volatile unsigned long lastFrameStartMicros = 0;
+
+            static void handleSignalFall()
+            {
+                auto const currentTime = TClock::Now();
+                if (attached->OnSignalFall(currentTime)) attached->lastFrameStartMicros = TClock::ToMicros(currentTime);
+            }
+
+            static void handleWake()
+            {
+                // Level interrupts fire continuously while the level is held,
+                // so the wake interrupt must be removed as soon as it fires
+                Hal::DetachInterrupt(ReceiverPin);
+            }
+
         public:
             /**
-             * Attach the receiver to the input pin via a pin interrupt
-             * It is the caller's responsibility to ensure that the provided
-             * pin is interrupt capable, configured as an input,
-             * and that the interrupt is free. No validation is performed
-             *
              * @param inverted Should be true if the attached receiver inverts
              * the signal when it is demodulated (true for most TSOPxx38 modules)
+             */
+            explicit InputPinIrReceiver(bool const inverted)
+                : inverted(inverted)
+            { }
+
+            InputPinIrReceiver(InputPinIrReceiver const &) = delete;
+            InputPinIrReceiver & operator=(InputPinIrReceiver const &) = delete;
+
+            ~InputPinIrReceiver()
+            {
+                Detach();
+            }
+
+            /**
+             * Configure the input pin and attach the receiver to it via a pin interrupt,
+             * replacing any other receiver attached to the pin
+             * It is the caller's responsibility to ensure that the provided
+             * pin is interrupt capable and that the interrupt is free.
+             * No validation is performed
+             *
+             * Safe to call from a global initialiser (i.e. before setup()),
+             * unless timing with CaptureTimerClock. The pin is configured
+             * before the interrupt is attached, and the receiver starts
+             * decoding as soon as the Arduino core enables interrupts,
+             * a few microseconds after reset
              *
-             * @returns The receiver instance
+             * @returns This receiver
              */
-            static IrReceiver& Attach(bool const inverted)
+            IrReceiver& Attach()
             {
-                attachInterrupt(
-                    digitalPinToInterrupt(ReceiverPin),
+                TClock::Start();
+                Hal::ConfigureInput(ReceiverPin);
+                // Pointer writes are not atomic on AVR, so the
+                // trampoline must not run while this is updated
+                Hal::DetachInterrupt(ReceiverPin);
+                attached = this;
+                pinReceiver<ReceiverPin> = this;
+                Hal::AttachInterrupt(
+                    ReceiverPin,
                     handleSignalFall,
-                    inverted ? RISING : FALLING);
-                return instance;
+                    inverted ? Hal::TRIGGER_RISING : Hal::TRIGGER_FALLING);
+                return *this;
             }
 
-            static void Detach()
+            /**
+             * Does nothing if this receiver is not the one attached to the pin,
+             * including when a receiver with another clock has replaced it
+             */
+            void Detach()
             {
-                detachInterrupt(digitalPinToInterrupt(ReceiverPin));
+                if (!isAttached()) return;
+                Hal::DetachInterrupt(ReceiverPin);
+                attached = nullptr;
+                pinReceiver<ReceiverPin> = nullptr;
             }
 
-            bool TryGetPacket(IrPacket & outPacket)
+            /**
+             * Waking the MCU relies on a LOW level interrupt (the only kind that
+             * can wake an AVR from power-down), so this is only supported for
+             * inverted receivers (which idle HIGH and pull the pin LOW during a
+             * carrier burst) that are attached to their pin
+             *
+             * The MCU wakes on the leading edge of the first burst, and the
+             * oscillator is running again within 1ms (16K clock cycles on AVR).
+             * The receiver only measures intervals between the trailing edges
+             * of bursts, the first of which arrives at the end of the 9ms AGC
+             * burst, so no timing information is lost while the MCU wakes up
+             */
+            bool PowerDownUntilSignal()
             {
-                if (packetReady)
-                {
-                    outPacket.Code = packet.Code;
-                    outPacket.IsRepeat = packet.IsRepeat;
-                    SetState(WAITING_FOR_PACKET);
-                    packetReady = false;
-                    return true;
-                }
-                else return false;
+                if (!inverted || !isAttached()) return false;
+
+                Hal::DetachInterrupt(ReceiverPin);
+                Hal::DisableInterrupts();
+                Hal::AttachInterrupt(ReceiverPin, handleWake, Hal::TRIGGER_LOW_LEVEL);
+                Hal::PowerDownUntilInterrupt();
+                Attach();
+                return true;
             }
 
-            volatile unsigned long GetLastCode() const
+            unsigned long GetLastFrameStartMicros() const
             {
-                return lastCode;
+                // Too wide to read atomically
+                Hal::DisableInterrupts();
+                auto const frameStartMicros = lastFrameStartMicros;
+                Hal::EnableInterrupts();
+                return frameStartMicros;
             }
     };
 }
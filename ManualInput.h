@@ -0,0 +1,180 @@
+#ifndef MANUAL_INPUT_H
+#define MANUAL_INPUT_H
+
+#include "Hal.h"
+#include "MotorDriver.h"
+
+namespace ManualInputUtils
+{
+    using namespace MotorDriverUtils;
+
+    /**
+     * Senses the knob being turned by hand
+     */
+    class ManualInput
+    {
+        public:
+            /**
+             * @param drivenOutput The direction the motor was last driven in. Movement
+             * in that direction is the motor's own, so is ignored. For any other output,
+             * movement in either direction counts
+             *
+             * @returns True iff. the knob has been turned by hand since the last call
+             */
+            virtual bool TakeManualMovement(MotorOutput const drivenOutput) = 0;
+    };
+
+// The inputs below need pin change interrupts, which are opt in on AVR. Define
+// HAL_PIN_CHANGE_INTERRUPTS before including any headers to use them
+#if defined(HAL_PIN_CHANGE_INTERRUPTS)
+
+    // Gray code transitions of a quadrature encoder, indexed by (previous AB << 2 | current AB)
+    // +1 is a step in the volume up direction. Invalid (skipped) transitions count as no step
+    int8_t const QUADRATURE_STEPS[16] = { 0, -1, 1, 0, 1, 0, 0, -1, -1, 0, 0, 1, 0, 1, -1, 0 };
+    // Steps further apart than this are not added together, so that occasional
+    // stray steps (e.g. vibration) never build up to a manual movement
+    unsigned long const QUADRATURE_STEP_WINDOW_MICROS = 250UL * 1000UL;
+
+    /**
+     * Quadrature encoder on the knob's shaft, with both channels on pin change
+     * capable pins. On AVR, both pins must be on the same port (e.g. A0 and A1),
+     * since each port has a single handler. If turning the knob towards volume up
+     * counts as manual movement while the motor drives it that way, swap the pins
+     *
+     * Only one encoder can be attached to each pair of pins at a time
+     */
+    template <int PinA, int PinB> class QuadratureManualInput final : public ManualInput
+    {
+        private:
+            inline static HAL_THREAD_LOCAL QuadratureManualInput<PinA, PinB> * attached = nullptr;
+
+            byte const thresholdSteps;
+            volatile int steps = 0; // Written inside the interrupt context
+            byte previousLevels = 0;
+            int pendingSteps = 0; // Steps taken from the interrupt context, not yet counted as movement
+            unsigned long lastStepMicros = 0;
+
+            static void handlePinChange()
+            {
+                attached->OnPinChange();
+            }
+
+            void OnPinChange()
+            {
+                previousLevels = ((previousLevels << 2) | Hal::ReadPins(PinA, PinB)) & 0x0F;
+                steps += QUADRATURE_STEPS[previousLevels];
+            }
+
+        public:
+            /**
+             * @param thresholdSteps Number of steps of movement needed to count as manual
+             * movement, so that backlash as the motor stops is not mistaken for the user
+             */
+            explicit QuadratureManualInput(byte const thresholdSteps = 2)
+                : thresholdSteps(thresholdSteps)
+            { }
+
+            ~QuadratureManualInput()
+            {
+                Detach();
+            }
+
+            void Attach()
+            {
+                Hal::ConfigureInput(PinA);
+                Hal::ConfigureInput(PinB);
+                Hal::DetachPinChangeInterrupt(PinA);
+                Hal::DetachPinChangeInterrupt(PinB);
+                previousLevels = Hal::ReadPins(PinA, PinB);
+                attached = this;
+                Hal::AttachPinChangeInterrupt(PinA, handlePinChange);
+                Hal::AttachPinChangeInterrupt(PinB, handlePinChange);
+            }
+
+            void Detach()
+            {
+                if (attached != this) return;
+                Hal::DetachPinChangeInterrupt(PinA);
+                Hal::DetachPinChangeInterrupt(PinB);
+                attached = nullptr;
+            }
+
+            bool TakeManualMovement(MotorOutput const drivenOutput)
+            {
+                Hal::DisableInterrupts();
+                int const newSteps = steps;
+                steps = 0;
+                Hal::EnableInterrupts();
+
+                if (newSteps)
+                {
+                    auto const currentMicros = Hal::Micros();
+                    if (currentMicros - lastStepMicros > QUADRATURE_STEP_WINDOW_MICROS) pendingSteps = 0;
+                    pendingSteps += newSteps;
+                    lastStepMicros = currentMicros;
+                }
+
+                int const opposingSteps = drivenOutput == MOTOR_VOLUME_UP ? -pendingSteps
+                    : drivenOutput == MOTOR_VOLUME_DOWN ? pendingSteps
+                    : pendingSteps < 0 ? -pendingSteps : pendingSteps;
+                // Movement in the driven direction is the motor's own, so does not
+                // count towards (or against) the next manual movement
+                if (opposingSteps < 0) pendingSteps = 0;
+                if (opposingSteps < thresholdSteps) return false;
+                pendingSteps = 0;
+                return true;
+            }
+    };
+
+    /**
+     * A sensor that pulses while a slip clutch between the motor and the knob
+     * slips, which only happens when the knob is held or turned against the
+     * motor. Since the clutch does not slip when the motor turns the knob
+     * freely, every pulse counts as manual movement
+     */
+    template <int SensorPin> class SlipManualInput final : public ManualInput
+    {
+        private:
+            inline static HAL_THREAD_LOCAL SlipManualInput<SensorPin> * attached = nullptr;
+
+            volatile bool slipped = false; // Written inside the interrupt context
+
+            static void handlePinChange()
+            {
+                attached->slipped = true;
+            }
+
+        public:
+            SlipManualInput() { }
+
+            ~SlipManualInput()
+            {
+                Detach();
+            }
+
+            void Attach()
+            {
+                Hal::ConfigureInput(SensorPin);
+                Hal::DetachPinChangeInterrupt(SensorPin);
+                attached = this;
+                Hal::AttachPinChangeInterrupt(SensorPin, handlePinChange);
+            }
+
+            void Detach()
+            {
+                if (attached != this) return;
+                Hal::DetachPinChangeInterrupt(SensorPin);
+                attached = nullptr;
+            }
+
+            bool TakeManualMovement(MotorOutput const)
+            {
+                bool const movement = slipped;
+                slipped = false;
+                return movement;
+            }
+    };
+#endif
+}
+
+#endif //MANUAL_INPUT_H
\ No newline at end of file
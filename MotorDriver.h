@@ -0,0 +1,352 @@
+#ifndef MOTOR_DRIVER_H
+#define MOTOR_DRIVER_H
+
+#include "Hal.h"
+
+namespace MotorDriverUtils
+{
+    enum MotorOutput
+    {
+        MOTOR_COAST, // Motor disconnected, free to spin down
+        MOTOR_VOLUME_UP, // Motor driven in the volume up direction
+        MOTOR_VOLUME_DOWN, // Motor driven in the volume down direction
+        MOTOR_BRAKE // Motor windings shorted
+    };
+
+    struct MotorDriverConfig
+    {
+        // See VolumeMotorConfig
+        int const VolumeUpPin;
+        int const VolumeDownPin;
+        int const EnablePin;
+        unsigned long const DeadTimeMicros;
+    };
+
+    /**
+     * Two logic inputs, one per side of the H-bridge. One input HIGH drives the
+     * motor in that direction and both HIGH brakes. Whether both LOW coasts or
+     * brakes depends on the driver (see each bridge)
+     */
+    class TwoInputBridge
+    {
+        protected:
+            int const volumeUpPin;
+            int const volumeDownPin;
+            int const enablePin;
+            bool upHigh = false;
+            bool downHigh = false;
+
+            /**
+             * Only writes when the inputs change, both at once, so that
+             * a direct reversal does not pass through brake
+             */
+            void writeInputs(bool const newUpHigh, bool const newDownHigh)
+            {
+                if (upHigh == newUpHigh && downHigh == newDownHigh) return;
+                Hal::WritePins(volumeUpPin, newUpHigh, volumeDownPin, newDownHigh);
+                upHigh = newUpHigh;
+                downHigh = newDownHigh;
+            }
+
+            /**
+             * For drivers whose enable pin (if connected) disables the bridge,
+             * leaving the motor to coast. Coasts by pulling it LOW, leaving the
+             * inputs alone, so the software PWM between driving and coasting
+             * toggles a single pin. Otherwise (enable tied HIGH) pulls both
+             * inputs LOW, which only coasts if the driver says so
+             */
+            void writeGated(MotorOutput const from, MotorOutput const to)
+            {
+                if (enablePin == Hal::NO_PIN) writeInputs(isUpHigh(to), isDownHigh(to));
+                else if (to == MOTOR_COAST) Hal::WritePin(enablePin, Hal::PIN_LOW);
+                else
+                {
+                    writeInputs(isUpHigh(to), isDownHigh(to));
+                    if (from == MOTOR_COAST) Hal::WritePin(enablePin, Hal::PIN_HIGH);
+                }
+            }
+
+            static bool isUpHigh(MotorOutput const output)
+            {
+                return output == MOTOR_VOLUME_UP || output == MOTOR_BRAKE;
+            }
+
+            static bool isDownHigh(MotorOutput const output)
+            {
+                return output == MOTOR_VOLUME_DOWN || output == MOTOR_BRAKE;
+            }
+
+            /**
+             * @param enabled Initial level of the enable pin
+             */
+            TwoInputBridge(MotorDriverConfig const & config, bool const enabled)
+                : volumeUpPin(config.VolumeUpPin)
+                , volumeDownPin(config.VolumeDownPin)
+                , enablePin(config.EnablePin)
+            {
+                Hal::WritePins(volumeUpPin, Hal::PIN_LOW, volumeDownPin, Hal::PIN_LOW);
+                Hal::ConfigureOutput(volumeUpPin);
+                Hal::ConfigureOutput(volumeDownPin);
+                if (enablePin != Hal::NO_PIN)
+                {
+                    Hal::WritePin(enablePin, enabled);
+                    Hal::ConfigureOutput(enablePin);
+                }
+            }
+
+        public:
+            void Tick() { }
+
+            void OnInputsLowered()
+            {
+                upHigh = false;
+                downHigh = false;
+            }
+    };
+
+    /**
+     * DRV8833 (AIN1/AIN2 on the volume up/down pins). Both inputs LOW coasts
+     * (fast decay) and both HIGH brakes (slow decay). The enable pin (if any)
+     * goes to nSLEEP, and is held HIGH, since the driver takes up to 1ms to
+     * wake from sleep, so sleeping cannot be used to coast
+     */
+    class Drv8833Bridge final : public TwoInputBridge
+    {
+        public:
+            Drv8833Bridge(MotorDriverConfig const & config)
+                : TwoInputBridge(config, /*enabled:*/true)
+            { }
+
+            void Write(MotorOutput const, MotorOutput const to)
+            {
+                writeInputs(isUpHigh(to), isDownHigh(to));
+            }
+    };
+
+    /**
+     * TB6612FNG (AIN1/AIN2 on the volume up/down pins, PWMA tied HIGH). Both inputs
+     * HIGH brakes and both LOW coasts. PWMA LOW brakes rather than coasts, so it
+     * is not used for the software PWM. The enable pin (if any) goes to STBY,
+     * which puts the driver in standby, letting the motor coast
+     */
+    class Tb6612Bridge final : public TwoInputBridge
+    {
+        public:
+            Tb6612Bridge(MotorDriverConfig const & config)
+                : TwoInputBridge(config, /*enabled:*/false)
+            { }
+
+            void Write(MotorOutput const from, MotorOutput const to)
+            {
+                writeGated(from, to);
+            }
+    };
+
+    /**
+     * Two logic inputs and an enable input (e.g. L298, L293D). With ENA HIGH, both
+     * inputs at the same level (LOW or HIGH) brake the motor, so only ENA LOW lets
+     * it coast. The enable pin goes to ENA. If ENA is tied HIGH (Hal::NO_PIN),
+     * the motor brakes wherever it would coast: MOTOR_COAST, the off part of each
+     * soft start and throttling period, the dead times, and the manual override,
+     * which then leaves the knob stiff to turn
+     */
+    class L298Bridge final : public TwoInputBridge
+    {
+        public:
+            L298Bridge(MotorDriverConfig const & config)
+                : TwoInputBridge(config, /*enabled:*/false)
+            { }
+
+            void Write(MotorOutput const from, MotorOutput const to)
+            {
+                writeGated(from, to);
+            }
+    };
+
+    // Continuous rotation servo pulse timing
+    unsigned long const SERVO_PERIOD_MICROS = 20000UL;
+    unsigned long const SERVO_NEUTRAL_MICROS = 1500UL;
+    unsigned long const SERVO_FULL_SPEED_OFFSET_MICROS = 500UL;
+
+#if defined(HAL_PULSE_OUTPUT)
+    /**
+     * A continuous rotation hobby servo on the volume up pin (set the volume down
+     * pin to the same pin). Driving sends full speed pulses, braking holds the
+     * servo at neutral, and coasting stops the pulses, so the servo goes limp
+     *
+     * Pulses are started from Tick, and ended by the HAL's pulse timer, so the
+     * main loop is not blocked, and its latency only delays the start of each
+     * period, not the pulse width. Needs HAL_PULSE_OUTPUT (on AVR, define it
+     * before the includes, which takes Timer2). The pulse is sampled at the start
+     * of each period, so soft start and throttling have little effect
+     */
+    class ServoBridge
+    {
+        private:
+            int const signalPin;
+            MotorOutput output = MOTOR_COAST;
+            unsigned long periodStartMicros = 0;
+
+        public:
+            ServoBridge(MotorDriverConfig const & config)
+                : signalPin(config.VolumeUpPin)
+            {
+                Hal::WritePin(signalPin, Hal::PIN_LOW);
+                Hal::ConfigureOutput(signalPin);
+            }
+
+            void Write(MotorOutput const, MotorOutput const to)
+            {
+                output = to;
+            }
+
+            /**
+             * Cuts the pulse in progress short, which the next period corrects
+             */
+            void OnInputsLowered() { }
+
+            void Tick()
+            {
+                if (output == MOTOR_COAST) return;
+                auto const currentMicros = Hal::Micros();
+                if (currentMicros - periodStartMicros < SERVO_PERIOD_MICROS) return;
+                periodStartMicros = currentMicros;
+
+                unsigned long const pulseMicros = output == MOTOR_VOLUME_UP
+                    ? SERVO_NEUTRAL_MICROS + SERVO_FULL_SPEED_OFFSET_MICROS
+                    : output == MOTOR_VOLUME_DOWN
+                        ? SERVO_NEUTRAL_MICROS - SERVO_FULL_SPEED_OFFSET_MICROS
+                        : SERVO_NEUTRAL_MICROS;
+                Hal::StartPulse(signalPin, pulseMicros);
+            }
+    };
+#endif
+
+    /**
+     * Applies motor outputs through a bridge, enforcing a dead time between
+     * driving the motor in one direction and driving it in the other
+     *
+     * A reversal coasts the motor, and the new direction is only applied once
+     * the dead time has passed, from Tick. The dead time is a minimum, since it
+     * can only end on a call to Tick
+     *
+     * @tparam TBridge Encodes motor outputs onto the driver chip's inputs.
+     * Must be constructible from MotorDriverConfig, and provide
+     * void Write(MotorOutput from, MotorOutput to), void Tick(), which is
+     * called frequently, and void OnInputsLowered(), which is called once
+     * the volume up and down pins have been driven LOW behind its back
+     */
+    template <class TBridge> class MotorDriver
+    {
+        private:
+            TBridge bridge;
+            unsigned long const deadTimeMicros;
+            MotorOutput output = MOTOR_COAST; // Currently applied output
+            MotorOutput requestedOutput = MOTOR_COAST; // Output to apply once the dead time has passed
+            MotorOutput lastDriveOutput = MOTOR_COAST; // Last direction in which the motor was driven
+            unsigned long driveEndMicros = 0; // Time the motor stopped being driven in that direction
+
+            static bool isDrive(MotorOutput const motorOutput)
+            {
+                return motorOutput == MOTOR_VOLUME_UP || motorOutput == MOTOR_VOLUME_DOWN;
+            }
+
+            void write(MotorOutput const newOutput)
+            {
+                if (isDrive(output))
+                {
+                    lastDriveOutput = output;
+                    driveEndMicros = Hal::Micros();
+                }
+                bridge.Write(output, newOutput);
+                output = newOutput;
+            }
+
+            bool deadTimePassed() const
+            {
+                return Hal::Micros() - driveEndMicros >= deadTimeMicros;
+            }
+
+            void apply()
+            {
+                if (requestedOutput == output) return;
+                MotorOutput const previousDriveOutput = isDrive(output) ? output : lastDriveOutput;
+                if (deadTimeMicros
+                    && isDrive(requestedOutput)
+                    && isDrive(previousDriveOutput)
+                    && requestedOutput != previousDriveOutput)
+                {
+                    if (isDrive(output)) write(MOTOR_COAST);
+                    if (!deadTimePassed()) return;
+                }
+                write(requestedOutput);
+            }
+
+        public:
+            MotorDriver(MotorDriverConfig const & config)
+                : bridge(config)
+                , deadTimeMicros(config.DeadTimeMicros)
+            { }
+
+            /**
+             * Drive the motor. Takes effect immediately, unless this reverses the
+             * motor within the dead time, in which case the motor coasts until
+             * Tick is called after the dead time has passed
+             */
+            void Set(MotorOutput const motorOutput)
+            {
+                requestedOutput = motorOutput;
+                apply();
+            }
+
+            /**
+             * Apply any output held back by the dead time. Call frequently
+             */
+            void Tick()
+            {
+                if (requestedOutput != output) apply();
+                bridge.Tick();
+            }
+
+            /**
+             * Apply the current output again, after the watchdog drove the
+             * volume up and down pins LOW (see WatchdogUtils::Pet)
+             */
+            void Resync()
+            {
+                bridge.OnInputsLowered();
+                bridge.Write(output, output);
+            }
+
+            /**
+             * @returns The output currently applied to the motor
+             */
+            MotorOutput GetOutput() const
+            {
+                return output;
+            }
+
+            /**
+             * @returns The direction the motor is being driven in, or was last
+             * driven in if it is not being driven. Coast if it never has been
+             */
+            MotorOutput GetDrivenOutput() const
+            {
+                return isDrive(output) ? output : lastDriveOutput;
+            }
+    };
+}
+
+// Select the bridge for the motor driver board at compile time, by defining
+// MOTOR_BRIDGE before including this header, e.g. as MotorDriverUtils::Tb6612Bridge,
+// or as your own class implementing the bridge interface described above
+#if !defined(MOTOR_BRIDGE)
+#define MOTOR_BRIDGE MotorDriverUtils::L298Bridge
+#endif
+
+namespace MotorDriverUtils
+{
+    typedef MotorDriver<MOTOR_BRIDGE> VolumeMotorDriver;
+}
+
+#endif //MOTOR_DRIVER_H
\ No newline at end of file
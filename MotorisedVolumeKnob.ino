@@ -7,15 +7,12 @@ using namespace VolumeMotorUtils;
 int const IR_RECV_PIN = 2;
 int const VOLUME_UP_PIN = 4;
 int const VOLUME_DOWN_PIN = 3;
+int const STATUS_LED_PIN = LED_BUILTIN;
 
-void setup()
-{
-    pinMode(IR_RECV_PIN, INPUT);
-    pinMode(VOLUME_UP_PIN, OUTPUT);
-    pinMode(VOLUME_DOWN_PIN, OUTPUT);
-}
-
-auto & receiver = InputPinIrReceiver<IR_RECV_PIN>::Attach(/*inverted:*/true);
+InputPinIrReceiver<IR_RECV_PIN> irReceiver(/*inverted:*/true);
+// Attached in a global initialiser so that the receiver is armed before
+// setup() runs. Attach() configures the input pin itself
+auto & receiver = irReceiver.Attach();
 
 auto motorStateMachine = VolumeMotorStateMachine(
     receiver,
@@ -26,10 +23,55 @@ auto motorStateMachine = VolumeMotorStateMachine(
         .VolumeUpPin = VOLUME_UP_PIN,
         .VolumeDownPin = VOLUME_DOWN_PIN,
         .BrakeDurationMicros = 100UL * 1000UL,
-        .MovementTimeoutMicros = 120UL * 1000UL
+        .MovementTimeoutMicros = 120UL * 1000UL,
+        .SoftStartMicros = 20UL * 1000UL,
+        .SupplySagMillivolts = 4300,
+        .IdlePowerDownMicros = 5UL * 1000UL * 1000UL,
+        .StatusLedPin = STATUS_LED_PIN,
+        .MaxMissedRepeats = 1,
+        .ReversalBrakeMicros = 50UL * 1000UL,
+        .ReversalDeadTimeMicros = 0,
+        .MotorDeadTimeMicros = 0,
+        // ENA tied HIGH, so the L298 brakes wherever the motor would coast
+        .MotorEnablePin = Hal::NO_PIN,
+        .ManualHoldOffMicros = 1000UL * 1000UL
     });
 
+MotorStateId lastStateId = IDLE;
+
+/**
+ * Telemetry for diagnosing the receiver (see Troubleshooting in README.md)
+ * The line overflows the serial transmit buffer, so printing blocks for about
+ * 1ms, which is harmless while the motor is at rest
+ */
+void printSignalQuality()
+{
+    auto const quality = receiver.GetSignalQuality();
+    Serial.print(F("Signal quality: grade "));
+    Serial.print(quality.Grade);
+    Serial.print(F(", score "));
+    Serial.print(quality.Score);
+    Serial.print(F(", repeats "));
+    Serial.print(quality.RepeatPercent);
+    Serial.print(F("%, invalid codes "));
+    Serial.print(quality.InvalidFramePercent);
+    Serial.print(F("%, jitter "));
+    Serial.print(quality.JitterMicros);
+    Serial.println(F("us"));
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    pinMode(STATUS_LED_PIN, OUTPUT);
+    motorStateMachine.EnableWatchdog(Hal::WATCHDOG_250MS);
+}
+
 void loop()
 {
     motorStateMachine.Tick();
+    // Reported when the motor comes to rest, as the status LED blinks the grade
+    auto const stateId = motorStateMachine.GetStateId();
+    if (stateId == IDLE && lastStateId != IDLE) printSignalQuality();
+    lastStateId = stateId;
 }
\ No newline at end of file
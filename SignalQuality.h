@@ -0,0 +1,236 @@
+#ifndef SIGNAL_QUALITY_H
+#define SIGNAL_QUALITY_H
+
+#include "Hal.h"
+
+namespace SignalQualityUtils
+{
+    // NEC transmitters send a repeat packet every 108ms while a button is held
+    unsigned long const REPEAT_PERIOD_MICROS = 108000UL;
+    // Longer gaps between repeats are treated as the button having been released
+    // and pressed again, rather than as missed repeats
+    byte const MAX_MISSED_REPEATS_COUNTED = 3;
+    // Number of expected repeats per measurement window. Reports cover
+    // the current window and the one before it
+    unsigned int const WINDOW_REPEATS = 32;
+    // Reports are not graded until at least this many repeats were expected
+    unsigned int const MINIMUM_GRADED_REPEATS = 8;
+
+    struct SignalQuality
+    {
+        // Percentage of the repeats expected while a button was held that were received
+        byte RepeatPercent;
+        // Percentage of codes (not repeats) that began with an AGC burst, but were abandoned part way through
+        byte InvalidFramePercent;
+        // Mean deviation of data bit intervals from their nominal duration
+        unsigned int JitterMicros;
+        // The worst of the above, as a score from 0 (unusable) to 100 (perfect)
+        byte Score;
+        // Score as a grade from 1 (replace the receiver) to 5 (perfect),
+        // or 0 if too few repeats have been received to judge
+        byte Grade;
+    };
+
+    /**
+     * Keeps rolling counts of repeat packets, decoded and abandoned codes, and bit timing
+     * deviation, from which it reports the receiver's signal quality
+     */
+    class SignalQualityMonitor
+    {
+        private:
+            struct Counts
+            {
+                unsigned int ExpectedRepeats;
+                unsigned int ReceivedRepeats;
+                unsigned int ValidCodes;
+                unsigned int InvalidFrames;
+                unsigned int JitterSamples;
+                unsigned long JitterMicros;
+            };
+
+            // Written inside the interrupt context. These run freely (and wrap),
+            // and the main thread works with differences between snapshots
+            volatile unsigned int validCodes = 0;
+            volatile unsigned int invalidFrames = 0;
+            volatile unsigned int jitterSamples = 0;
+            volatile unsigned long jitterMicros = 0;
+
+            // Only accessed from the main thread
+            Counts previousWindow = { };
+            Counts windowStart = { };
+            unsigned int expectedRepeats = 0;
+            unsigned int receivedRepeats = 0;
+            unsigned long lastPacketMicros = 0;
+            bool lastPacketWasRepeat = false;
+
+            Counts currentWindow() const
+            {
+                Hal::DisableInterrupts();
+                Counts counts =
+                {
+                    expectedRepeats,
+                    receivedRepeats,
+                    static_cast<unsigned int>(validCodes - windowStart.ValidCodes),
+                    static_cast<unsigned int>(invalidFrames - windowStart.InvalidFrames),
+                    static_cast<unsigned int>(jitterSamples - windowStart.JitterSamples),
+                    jitterMicros - windowStart.JitterMicros
+                };
+                Hal::EnableInterrupts();
+                return counts;
+            }
+
+        public:
+            /**
+             * Call from the interrupt context for each data bit accepted
+             */
+            void RecordBit(unsigned int const deviationMicros)
+            {
+                jitterSamples++;
+                jitterMicros += deviationMicros;
+            }
+
+            /**
+             * Call from the interrupt context for each code received. Repeats are
+             * not counted, since they cannot be abandoned part way through
+             */
+            void RecordValidCode()
+            {
+                validCodes++;
+            }
+
+            /**
+             * Call from the interrupt context when a frame is abandoned part way through
+             */
+            void RecordInvalidFrame()
+            {
+                invalidFrames++;
+            }
+
+            /**
+             * Call from the main thread for each packet read from the receiver
+             * Only gaps between consecutive repeats are counted, since the gap
+             * between a code and its first repeat depends on the code
+             */
+            void RecordPacketRead(bool const isRepeat, unsigned long const currentMicros)
+            {
+                unsigned long const gapMicros = currentMicros - lastPacketMicros;
+                if (isRepeat
+                    && lastPacketWasRepeat
+                    && gapMicros < (MAX_MISSED_REPEATS_COUNTED + 1) * REPEAT_PERIOD_MICROS + REPEAT_PERIOD_MICROS / 2)
+                {
+                    unsigned int const periods = (gapMicros + REPEAT_PERIOD_MICROS / 2) / REPEAT_PERIOD_MICROS;
+                    expectedRepeats += periods ? periods : 1;
+                    receivedRepeats++;
+
+                    if (expectedRepeats >= WINDOW_REPEATS)
+                    {
+                        previousWindow = currentWindow();
+                        Hal::DisableInterrupts();
+                        windowStart = { 0, 0, validCodes, invalidFrames, jitterSamples, jitterMicros };
+                        Hal::EnableInterrupts();
+                        expectedRepeats = 0;
+                        receivedRepeats = 0;
+                    }
+                }
+                lastPacketMicros = currentMicros;
+                lastPacketWasRepeat = isRepeat;
+            }
+
+            /**
+             * @param jitterLimitMicros Mean deviation at which the jitter
+             * alone would make the signal unusable (e.g. the decoder's window)
+             */
+            SignalQuality const GetSignalQuality(unsigned long const jitterLimitMicros) const
+            {
+                auto const current = currentWindow();
+                unsigned int const expected = previousWindow.ExpectedRepeats + current.ExpectedRepeats;
+                unsigned int const received = previousWindow.ReceivedRepeats + current.ReceivedRepeats;
+                unsigned long const valid = previousWindow.ValidCodes + current.ValidCodes;
+                unsigned long const invalid = previousWindow.InvalidFrames + current.InvalidFrames;
+                unsigned long const samples = previousWindow.JitterSamples + current.JitterSamples;
+                unsigned long const deviation = previousWindow.JitterMicros + current.JitterMicros;
+
+                SignalQuality quality;
+                quality.RepeatPercent = expected ? 100UL * received / expected : 100;
+                quality.InvalidFramePercent = valid + invalid ? 100UL * invalid / (valid + invalid) : 0;
+                quality.JitterMicros = samples ? deviation / samples : 0;
+
+                // Demodulators stretch and shrink bursts slightly, so jitter up to
+                // a quarter of the limit is normal and not penalised
+                unsigned long const toleratedMicros = jitterLimitMicros / 4;
+                byte const jitterScore = quality.JitterMicros <= toleratedMicros
+                    ? 100
+                    : quality.JitterMicros >= jitterLimitMicros
+                        ? 0
+                        : 100UL * (jitterLimitMicros - quality.JitterMicros) / (jitterLimitMicros - toleratedMicros);
+                quality.Score = quality.RepeatPercent;
+                if (100 - quality.InvalidFramePercent < quality.Score) quality.Score = 100 - quality.InvalidFramePercent;
+                if (jitterScore < quality.Score) quality.Score = jitterScore;
+
+                if (expected < MINIMUM_GRADED_REPEATS) quality.Grade = 0;
+                // Every missed repeat can make the motor stutter, so grades are strict
+                else if (quality.Score >= 98) quality.Grade = 5;
+                else if (quality.Score >= 90) quality.Grade = 4;
+                else if (quality.Score >= 75) quality.Grade = 3;
+                else if (quality.Score >= 50) quality.Grade = 2;
+                else quality.Grade = 1;
+                return quality;
+            }
+    };
+
+    // Status LED blink timing
+    unsigned long const BLINK_ON_MICROS = 200UL * 1000UL;
+    unsigned long const BLINK_OFF_MICROS = 300UL * 1000UL;
+
+    /**
+     * Blinks a grade on a status LED without blocking
+     */
+    class GradeBlinker
+    {
+        private:
+            int const pin;
+            byte phasesRemaining = 0; // Two phases (on, then off) per blink
+            unsigned long phaseMicros = 0;
+
+        public:
+            /**
+             * @param pin Output pin with the LED attached. Hal::NO_PIN disables blinking
+             */
+            GradeBlinker(int const pin)
+                : pin(pin)
+            { }
+
+            void Start(byte const grade)
+            {
+                if (pin == Hal::NO_PIN || !grade) return;
+                phasesRemaining = grade * 2;
+                phaseMicros = 0;
+                Hal::WritePin(pin, Hal::PIN_HIGH);
+            }
+
+            void Stop()
+            {
+                if (!phasesRemaining) return;
+                phasesRemaining = 0;
+                Hal::WritePin(pin, Hal::PIN_LOW);
+            }
+
+            void Tick(unsigned long const deltaMicros)
+            {
+                if (!phasesRemaining) return;
+                phaseMicros += deltaMicros;
+                bool const on = phasesRemaining % 2 == 0;
+                if (phaseMicros < (on ? BLINK_ON_MICROS : BLINK_OFF_MICROS)) return;
+                phaseMicros = 0;
+                if (--phasesRemaining) Hal::WritePin(pin, !on);
+                else Hal::WritePin(pin, Hal::PIN_LOW);
+            }
+
+            bool IsBlinking() const
+            {
+                return phasesRemaining != 0;
+            }
+    };
+}
+
+#endif //SIGNAL_QUALITY_H
\ No newline at end of file
@@ -0,0 +1,252 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#if !defined(HAL_HOST)
+#error "Simulation.h runs on the host simulation backend. Define HAL_HOST"
+#endif
+
+#include <algorithm>
+#include <limits.h>
+#include <vector>
+#include "IrReceiver.h"
+
+/**
+ * Drives state machines through scripted scenarios in simulated time,
+ * without an interrupt or a real receiver, so that the motor logic can
+ * be exercised on the host many times faster than real time
+ */
+namespace SimulationUtils
+{
+    using namespace IrReceiverUtils;
+
+    // Default simulated time between calls to loop()
+    unsigned long const DEFAULT_TICK_MICROS = 50UL;
+
+    struct ScriptedPacket
+    {
+        unsigned long Micros;
+        IrPacket Packet;
+    };
+
+    /**
+     * Delivers scheduled packets once the simulated clock reaches their time.
+     * Packets are delivered in time order, one per read, and late reads
+     * receive them late, as with a real receiver
+     */
+    class ScriptedIrReceiver final : public IrReceiver
+    {
+        private:
+            std::vector<ScriptedPacket> packets;
+            std::vector<unsigned long> garbledFrameMicros; // Frames that did not complete a packet
+            size_t next = 0;
+            unsigned long lastCode = 0;
+            unsigned long lastPacketMicros = 0;
+            SignalQuality signalQuality = { 100, 0, 0, 100, 0 };
+            bool motorActive = false;
+            unsigned long powerDownCount = 0;
+
+            static bool isEarlier(ScriptedPacket const & first, ScriptedPacket const & second)
+            {
+                return first.Micros < second.Micros;
+            }
+
+        public:
+            /**
+             * Schedule a packet. Packets may be scheduled in any order,
+             * but not before those already delivered
+             */
+            void Schedule(unsigned long const micros, IrPacket const packet)
+            {
+                auto const scripted = ScriptedPacket { micros, packet };
+                packets.insert(std::upper_bound(packets.begin() + next, packets.end(), scripted, isEarlier), scripted);
+            }
+
+            void ScheduleCode(unsigned long const micros, unsigned long const code)
+            {
+                Schedule(micros, IrPacket { false, code });
+            }
+
+            void ScheduleRepeat(unsigned long const micros)
+            {
+                Schedule(micros, IrPacket { true, 0 });
+            }
+
+            /**
+             * Schedule a held button: its code, followed by repeats every REPEAT_PERIOD_MICROS
+             */
+            void ScheduleHold(unsigned long const startMicros, unsigned long const code, unsigned int const repeats)
+            {
+                ScheduleCode(startMicros, code);
+                for (unsigned int i = 1; i <= repeats; i++) ScheduleRepeat(startMicros + i * REPEAT_PERIOD_MICROS);
+            }
+
+            /**
+             * Schedule a frame that the receiver sees start, but which is garbled,
+             * so no packet is delivered (see GetLastFrameStartMicros)
+             *
+             * @param micros When the packet would have been delivered
+             */
+            void ScheduleGarbledFrame(unsigned long const micros)
+            {
+                garbledFrameMicros.push_back(micros);
+            }
+
+            /**
+             * Overrides the last code, until the next code is delivered
+             */
+            void SetLastCode(unsigned long const code)
+            {
+                lastCode = code;
+            }
+
+            void SetSignalQuality(SignalQuality const quality)
+            {
+                signalQuality = quality;
+            }
+
+            /**
+             * @returns The time that the next packet is scheduled for, or ULONG_MAX if there are none
+             */
+            unsigned long GetNextPacketMicros() const
+            {
+                return next == packets.size() ? ULONG_MAX : packets[next].Micros;
+            }
+
+            /**
+             * @returns The number of scheduled packets not yet delivered
+             */
+            size_t GetPendingCount() const
+            {
+                return packets.size() - next;
+            }
+
+            bool IsMotorActive() const
+            {
+                return motorActive;
+            }
+
+            unsigned long GetPowerDownCount() const
+            {
+                return powerDownCount;
+            }
+
+            bool TryGetPacket(IrPacket & outPacket)
+            {
+                if (next == packets.size() || Hal::Micros() < packets[next].Micros) return false;
+                outPacket = packets[next].Packet;
+                lastPacketMicros = packets[next++].Micros;
+                if (!outPacket.IsRepeat) lastCode = outPacket.Code;
+                return true;
+            }
+
+            unsigned long GetLastCode() const
+            {
+                return lastCode;
+            }
+
+            /**
+             * Counts the request, and returns as though woken straight away
+             */
+            bool PowerDownUntilSignal()
+            {
+                powerDownCount++;
+                return true;
+            }
+
+            void SetMotorActive(bool const active)
+            {
+                motorActive = active;
+            }
+
+            SignalQuality const GetSignalQuality() const
+            {
+                return signalQuality;
+            }
+
+            /**
+             * @returns The start of the latest of the delivered packets and the garbled
+             * frames seen so far. Each is taken to have started as a repeat does,
+             * REPEAT_DURATION before it would be delivered
+             */
+            unsigned long GetLastFrameStartMicros() const
+            {
+                auto const currentMicros = Hal::Micros();
+                unsigned long lastFrameMicros = lastPacketMicros;
+                for (auto const micros : garbledFrameMicros)
+                {
+                    if (micros <= currentMicros && micros > lastFrameMicros) lastFrameMicros = micros;
+                }
+                return lastFrameMicros - REPEAT_DURATION;
+            }
+    };
+
+    /**
+     * Ticks a state machine at a fixed period of simulated time, as loop()
+     * would. Call Hal::Host::Reset() before constructing the state machine,
+     * since constructing it configures the simulated pins
+     *
+     * @tparam TStateMachine Any class with void Tick(), e.g. VolumeMotorStateMachine
+     */
+    template <class TStateMachine> class VirtualTimeDriver
+    {
+        private:
+            TStateMachine & stateMachine;
+            unsigned long const tickMicros;
+
+        public:
+            VirtualTimeDriver(TStateMachine & stateMachine, unsigned long const tickMicros = DEFAULT_TICK_MICROS)
+                : stateMachine(stateMachine)
+                , tickMicros(tickMicros)
+            { }
+
+            /**
+             * Advance the clock by one period, then tick
+             */
+            void Step()
+            {
+                Hal::Host::AdvanceMicros(tickMicros);
+                stateMachine.Tick();
+            }
+
+            /**
+             * Advance the clock to the given time (or by one period, if that is later), then
+             * tick. Only for stretches in which the ticks skipped would do nothing, such as
+             * while idle until the receiver's next packet (see GetNextPacketMicros)
+             */
+            void SkipTo(unsigned long const micros)
+            {
+                if (micros > Hal::Micros() + tickMicros) Hal::Host::AdvanceMicros(micros - Hal::Micros() - tickMicros);
+                Step();
+            }
+
+            /**
+             * Tick until the clock reaches endMicros, calling observe() after each tick
+             * Stops early if observe returns false
+             */
+            template <class TObserver> void RunUntil(unsigned long const endMicros, TObserver observe)
+            {
+                while (Hal::Micros() < endMicros)
+                {
+                    Step();
+                    if (!observe()) return;
+                }
+            }
+
+            void RunUntil(unsigned long const endMicros)
+            {
+                RunUntil(endMicros, []() { return true; });
+            }
+
+            template <class TObserver> void RunFor(unsigned long const durationMicros, TObserver observe)
+            {
+                RunUntil(Hal::Micros() + durationMicros, observe);
+            }
+
+            void RunFor(unsigned long const durationMicros)
+            {
+                RunUntil(Hal::Micros() + durationMicros);
+            }
+    };
+}
+
+#endif //SIMULATION_H
\ No newline at end of file
@@ -1,16 +1,22 @@
 #ifndef STATE_MACHINE_H
 #define STATE_MACHINE_H
 
+#include "Hal.h"
+
 namespace StateMachineUtils
 {
-    template <class TStateId> class State
+    /**
+     * @tparam TDeltaMicros The type that the time between ticks is passed as.
+     * A narrower type (e.g. uint16_t) saturates at its largest value
+     */
+    template <class TStateId, class TDeltaMicros = unsigned long> class State
     {
         public:
             /**
              * @param deltaMicros The time (in microseconds) since the last tick of the state machine
              * @return The new state of the state machine
              */
-            virtual TStateId const Tick(unsigned long const deltaMicros) = 0;
+            virtual TStateId Tick(TDeltaMicros const deltaMicros) = 0;
 
             /**
              * Called when the state machine enters this state.
@@ -21,17 +27,113 @@ namespace StateMachineUtils
             virtual void OnEnterState() = 0;
     };
 
-    unsigned long const Duration(unsigned long const startMicros, unsigned long const endMicros)
+    unsigned long Duration(unsigned long const startMicros, unsigned long const endMicros)
     {
         if(startMicros > endMicros) return startMicros - endMicros;
         else return endMicros - startMicros;
     }
 
-    template <class TStateId> class StateMachine
+    /**
+     * @returns micros, or the largest TDeltaMicros if it does not fit
+     */
+    template <class TDeltaMicros> TDeltaMicros SaturateMicros(unsigned long const micros)
+    {
+        TDeltaMicros const largest = static_cast<TDeltaMicros>(~TDeltaMicros(0));
+        return micros > largest ? largest : static_cast<TDeltaMicros>(micros);
+    }
+
+    /**
+     * Clock policies supply the time that a StateMachine measures ticks with.
+     * Each provides a Time type, Start(), Now(), ElapsedMicros(start, end),
+     * and ToMicros(time), which converts a time to the Hal::Micros timebase
+     */
+    struct MicrosClock
+    {
+        typedef unsigned long Time;
+
+        static void Start() { }
+
+        static Time Now()
+        {
+            return Hal::Micros();
+        }
+
+        static unsigned long ElapsedMicros(Time const start, Time const end)
+        {
+            return Duration(start, end);
+        }
+
+        static unsigned long ToMicros(Time const time)
+        {
+            return time;
+        }
+    };
+
+    /**
+     * Measures short intervals with the capture timer, to the nearest microsecond,
+     * rather than to the resolution of Hal::Micros (4 microseconds on a 16MHz AVR)
+     *
+     * The 16 bit counter wraps every 32ms (at 2 ticks per microsecond), so
+     * alone it would alias long idle gaps onto short intervals. Hal::Micros is
+     * read alongside it to tell them apart, and measures the long intervals
+     *
+     * This buys resolution, not speed: each reading costs a capture timer read
+     * on top of Hal::Micros. The counter's half microsecond ticks are rounded to
+     * whole microseconds, since the decoder's windows and intervals (DecodeMicros)
+     * are in microseconds. Keeping the half microseconds would mean scaling every
+     * decoder constant, for a resolution well below the demodulator's own jitter
+     *
+     * On AVR the capture timer is Timer1, which the Arduino core configures
+     * for analogWrite() in init(), after global initialisers have run. So
+     * Start() must be called from setup() (or later)
+     */
+    struct CaptureTimerClock
+    {
+        struct Time
+        {
+            unsigned long Micros;
+            uint16_t Ticks;
+        };
+
+        // Intervals shorter than this (by Hal::Micros) are measured with the capture timer.
+        // Half of the counter's period, which leaves ample margin for the two clocks
+        // being read a few microseconds apart
+        static unsigned long const FINE_LIMIT_MICROS = 0x8000UL / Hal::CAPTURE_TIMER_TICKS_PER_MICRO;
+
+        static void Start()
+        {
+            Hal::StartCaptureTimer();
+        }
+
+        static Time Now()
+        {
+            return Time { Hal::Micros(), static_cast<uint16_t>(Hal::ReadCaptureTimer()) };
+        }
+
+        static unsigned long ElapsedMicros(Time const start, Time const end)
+        {
+            unsigned long const coarseMicros = Duration(start.Micros, end.Micros);
+            if (coarseMicros >= FINE_LIMIT_MICROS) return coarseMicros;
+            // Correct across a wrap of the counter
+            uint16_t const ticks = end.Ticks - start.Ticks;
+            return (ticks + Hal::CAPTURE_TIMER_TICKS_PER_MICRO / 2) / Hal::CAPTURE_TIMER_TICKS_PER_MICRO;
+        }
+
+        static unsigned long ToMicros(Time const time)
+        {
+            return time.Micros;
+        }
+    };
+
+    /**
+     * @tparam TClock The clock policy that ticks are timed with (see MicrosClock)
+     * @tparam TDeltaMicros The type that states receive the time between ticks as (see State)
+     */
+    template <class TStateId, class TClock = MicrosClock, class TDeltaMicros = unsigned long> class StateMachine
     {
         private:
-            State<TStateId> * currentState;
-            unsigned long lastTickMicros = 0;
+            State<TStateId, TDeltaMicros> * currentState;
+            typename TClock::Time lastTickTime = { };
             TStateId currentStateId;
 
         protected:
@@ -49,21 +151,52 @@ namespace StateMachineUtils
              * @param stateId An identifier representing a state
              * @return Pointer to a state object corresponding with the given id
              */
-            virtual State<TStateId> * GetStateInstance(TStateId const stateIdentifier) const = 0;
+            virtual State<TStateId, TDeltaMicros> * GetStateInstance(TStateId const stateIdentifier) = 0;
+
+            unsigned long GetLastTickMicros() const
+            {
+                return TClock::ToMicros(lastTickTime);
+            }
+
+            TDeltaMicros GetMicrosSinceLastTick(typename TClock::Time const currentTime) const
+            {
+                return SaturateMicros<TDeltaMicros>(TClock::ElapsedMicros(lastTickTime, currentTime));
+            }
+
+            /**
+             * @param deltaMicros From GetMicrosSinceLastTick(currentTime), for callers
+             * that have already measured it (e.g. to filter glitches)
+             */
+            void Tick(typename TClock::Time const currentTime, TDeltaMicros const deltaMicros)
+            {
+                SetState(currentState->Tick(deltaMicros));
+                lastTickTime = currentTime;
+            }
 
         public:
             StateMachine(
                 TStateId const initialStateId,
-                State<TStateId> * currentState)
-                : currentStateId(initialStateId)
-                , currentState(currentState)
+                State<TStateId, TDeltaMicros> * currentState)
+                : currentState(currentState)
+                , currentStateId(initialStateId)
             { }
 
             void Tick()
             {
-                auto const currentMicros = micros();
-                SetState(currentState->Tick(Duration(lastTickMicros, currentMicros)));
-                lastTickMicros = currentMicros;
+                Tick(TClock::Now());
+            }
+
+            TStateId GetStateId() const
+            {
+                return currentStateId;
+            }
+
+            /**
+             * @param currentTime The current time (from TClock::Now), for callers that have already read it
+             */
+            void Tick(typename TClock::Time const currentTime)
+            {
+                Tick(currentTime, GetMicrosSinceLastTick(currentTime));
             }
     };
 }
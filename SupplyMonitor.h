@@ -0,0 +1,61 @@
+#ifndef SUPPLY_MONITOR_H
+#define SUPPLY_MONITOR_H
+
+#include "Hal.h"
+
+namespace SupplyMonitorUtils
+{
+    // The AVR bandgap reference needs ~1ms to settle after being selected,
+    // so the first few conversions (~104us each) are discarded
+    byte const SETTLING_CONVERSIONS = 10;
+
+    /**
+     * Measures the supply voltage in the background without blocking
+     * On AVR, this assumes exclusive use of the ADC (see HalAvr.h)
+     */
+    class SupplyMonitor
+    {
+        private:
+            unsigned int millivolts = 0;
+            byte conversionsRemainingToSettle = SETTLING_CONVERSIONS;
+            bool converting = false;
+
+        public:
+            /**
+             * Collect the result of the previous conversion (if finished)
+             * and start the next one. Call frequently
+             *
+             * @returns True iff. a new reading is available from GetMillivolts
+             */
+            bool Poll()
+            {
+                if (converting && !Hal::IsSupplyConversionComplete()) return false;
+
+                bool newReading = false;
+                if (converting)
+                {
+                    unsigned int const reading = Hal::ReadSupplyMillivolts();
+                    if (conversionsRemainingToSettle) conversionsRemainingToSettle--;
+                    else if (reading)
+                    {
+                        millivolts = reading;
+                        newReading = true;
+                    }
+                }
+                Hal::StartSupplyConversion();
+                converting = true;
+                return newReading;
+            }
+
+            /**
+             * @returns The most recently measured supply voltage, in millivolts
+             * Returns zero until the first valid reading is available
+             */
+            unsigned int GetMillivolts() const
+            {
+                return millivolts;
+            }
+    };
+}
+
+#endif //SUPPLY_MONITOR_H
\ No newline at end of file
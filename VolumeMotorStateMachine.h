@@ -1,14 +1,33 @@
 #ifndef VOLUME_MOTOR_STATE_MACHINE_H
 #define VOLUME_MOTOR_STATE_MACHINE_H
 
-#include "Arduino.h"
+#include "Hal.h"
 #include "StateMachine.h"
 #include "IrReceiver.h"
+#include "ManualInput.h"
+#include "MotorDriver.h"
+#include "SignalQuality.h"
+#include "SupplyMonitor.h"
+#include "Watchdog.h"
 
 namespace VolumeMotorUtils
 {
     using namespace IrReceiverUtils;
+    using namespace ManualInputUtils;
+    using namespace MotorDriverUtils;
     using namespace StateMachineUtils;
+    using namespace SignalQualityUtils;
+    using namespace SupplyMonitorUtils;
+
+    // Period of the software PWM used to soft-start and throttle the motor
+    unsigned long const PWM_PERIOD_MICROS = 2000UL;
+    byte const FULL_DUTY = 255;
+    // Throttling never reduces the duty below this, so that the motor keeps moving
+    byte const MINIMUM_THROTTLED_DUTY = 64;
+    // Repeats arriving within this of a multiple of the repeat period are on cadence
+    unsigned long const REPEAT_CADENCE_TOLERANCE_MICROS = 10UL * 1000UL;
+    // Missed repeats are only bridged after this many consecutive repeats on cadence
+    byte const MINIMUM_CADENCE_REPEATS = 2;
 
     struct VolumeMotorConfig
     {
@@ -26,6 +45,54 @@ namespace VolumeMotorUtils
         unsigned long const BrakeDurationMicros;
         // Duration to wait since last IR code before stopping
         unsigned long const MovementTimeoutMicros;
+
+        // Duration over which to ramp up the motor drive after it starts moving,
+        // limiting the inrush current. Zero starts the motor at full drive
+        unsigned long const SoftStartMicros;
+        // Supply voltage below which the motor drive is throttled, to stop the motor
+        // dragging the supply down far enough to upset the IR demodulator.
+        // Zero disables supply monitoring
+        unsigned int const SupplySagMillivolts;
+
+        // Duration to remain idle before putting the MCU into power-down
+        // sleep until the next IR signal arrives. Zero disables sleeping
+        unsigned long const IdlePowerDownMicros;
+
+        // Digital output pin with a status LED, which blinks the receiver's signal
+        // quality grade (see SignalQuality) each time the motor comes to rest.
+        // Hal::NO_PIN disables the status LED
+        int const StatusLedPin;
+
+        // Number of consecutive missed repeats to ride through without braking.
+        // Only applies once repeats have been arriving on cadence, and only when
+        // the receiver saw a (garbled) frame start where the missing repeat should
+        // have been, so the motor still stops promptly when the button is released.
+        // Needs a MovementTimeoutMicros longer than REPEAT_PERIOD_MICROS.
+        // Zero brakes on the first missed repeat
+        byte const MaxMissedRepeats;
+
+        // Duration to brake the motor when reversing direction, before driving it the
+        // other way, which limits the current spike from reversing at full speed
+        unsigned long const ReversalBrakeMicros;
+        // Duration to leave both outputs off between braking and driving in the new
+        // direction when reversing. Zero for both reverses immediately
+        unsigned long const ReversalDeadTimeMicros;
+
+        // Minimum time between driving the motor in one direction and driving it in
+        // the other, during which the motor coasts. Guards against shoot-through in
+        // drivers without their own protection. Zero disables
+        unsigned long const MotorDeadTimeMicros;
+
+        // Digital output pin connected to the motor driver's enable input (ENA on the
+        // L298, nSLEEP on the DRV8833, STBY on the TB6612). Hal::NO_PIN if it is tied HIGH,
+        // in which case an L298 brakes the motor wherever it would coast (see L298Bridge).
+        // The driver board is selected with MOTOR_BRIDGE (see MotorDriver.h)
+        int const MotorEnablePin;
+
+        // Duration to ignore the remote for after the knob is turned by hand while
+        // the motor is running, so that the motor does not fight the user. Only
+        // applies when a manual input is enabled (see EnableManualOverride)
+        unsigned long const ManualHoldOffMicros;
     };
 
     enum MotorStateId
@@ -33,57 +100,89 @@ namespace VolumeMotorUtils
         IDLE,
         VOLUME_INCREASING,
         VOLUME_DECREASING,
-        BRAKING
+        BRAKING,
+        REVERSING_TO_INCREASING, // Braking (then off) before driving the motor in the volume up direction
+        REVERSING_TO_DECREASING, // Braking (then off) before driving the motor in the volume down direction
+        MANUAL_OVERRIDE // Idle, and ignoring the remote, because the knob was turned by hand
     };
 
-    class IdleMotorState : public State<MotorStateId>
+    class IdleMotorState final : public State<MotorStateId>
     {
         private:
             IrReceiver & irReceiver;
             VolumeMotorConfig const & config;
+            VolumeMotorDriver & motorDriver;
+            GradeBlinker & statusLed;
+            unsigned long idleTimeMicros = 0; // Time since entering idle or waking from sleep
 
         public:
             IdleMotorState(
                 IrReceiver & irReceiver,
-                VolumeMotorConfig const & config)
+                VolumeMotorConfig const & config,
+                VolumeMotorDriver & motorDriver,
+                GradeBlinker & statusLed)
                 : irReceiver(irReceiver)
                 , config(config)
+                , motorDriver(motorDriver)
+                , statusLed(statusLed)
             { }
 
-            MotorStateId const Tick(unsigned long const)
+            MotorStateId Tick(unsigned long const deltaMicros)
             {
                 IrPacket packet;
                 if (irReceiver.TryGetPacket(packet) && !packet.IsRepeat)
                 {
-                    if (packet.Code == config.VolumeUpCode) return VOLUME_INCREASING;
-                    else if (packet.Code == config.VolumeDownCode) return VOLUME_DECREASING;
+                    if (packet.Code == config.VolumeUpCode || packet.Code == config.VolumeDownCode)
+                    {
+                        statusLed.Stop();
+                        return packet.Code == config.VolumeUpCode ? VOLUME_INCREASING : VOLUME_DECREASING;
+                    }
+                }
+
+                statusLed.Tick(deltaMicros);
+                idleTimeMicros += deltaMicros;
+                // The LED would stay lit through sleep if sleep began part way through a blink
+                if (config.IdlePowerDownMicros && idleTimeMicros >= config.IdlePowerDownMicros && !statusLed.IsBlinking())
+                {
+                    // Restart the count whether or not sleep is supported, so that
+                    // a spurious wake-up (or a lack of support) does not cause the
+                    // receiver to be re-armed on every tick
+                    WatchdogUtils::Suspend();
+                    irReceiver.PowerDownUntilSignal();
+                    WatchdogUtils::Resume();
+                    idleTimeMicros = 0;
                 }
                 return IDLE;
             }
 
             void OnEnterState()
             {
-                digitalWrite(config.VolumeUpPin, LOW);
-                digitalWrite(config.VolumeDownPin, LOW);
+                idleTimeMicros = 0;
+                irReceiver.SetMotorActive(false);
+                motorDriver.Set(MOTOR_COAST);
+                statusLed.Start(irReceiver.GetSignalQuality().Grade);
             }
     };
 
-    class BrakingMotorState : public State<MotorStateId>
+    class BrakingMotorState final : public State<MotorStateId>
     {
         private:
             IrReceiver & irReceiver;
             VolumeMotorConfig const & config;
+            VolumeMotorDriver & motorDriver;
             unsigned long brakeTimeMicros = 0; // Time that motor has been braking for
 
         public:
             BrakingMotorState(
                 IrReceiver & irReceiver,
-                VolumeMotorConfig const & config)
+                VolumeMotorConfig const & config,
+                VolumeMotorDriver & motorDriver)
                 : irReceiver(irReceiver)
                 , config(config)
+                , motorDriver(motorDriver)
             { }
 
-            MotorStateId const Tick(unsigned long const deltaMicros)
+            MotorStateId Tick(unsigned long const deltaMicros)
             {
                 if (irReceiver.TryGetPacket())
                 {
@@ -101,8 +200,122 @@ namespace VolumeMotorUtils
             void OnEnterState()
             {
                 brakeTimeMicros = 0;
-                digitalWrite(config.VolumeUpPin, HIGH);
-                digitalWrite(config.VolumeDownPin, HIGH);
+                // Braking shorts the motor windings, which is as noisy as driving it
+                irReceiver.SetMotorActive(true);
+                motorDriver.Set(MOTOR_BRAKE);
+            }
+    };
+
+    template <bool const VolumeUp> class MovingMotorState;
+
+    /**
+     * Brakes the motor, and then leaves it off for the dead time,
+     * before handing over to the moving state for the new direction
+     */
+    template <bool const VolumeUp> class ReversingMotorState final : public State<MotorStateId>
+    {
+        private:
+            IrReceiver & irReceiver;
+            VolumeMotorConfig const & config;
+            VolumeMotorDriver & motorDriver;
+            MovingMotorState<VolumeUp> & targetMovingState;
+            unsigned long reversingMicros = 0; // Time since the reversal began
+            unsigned long microsSinceLastTargetCommand = 0; // Time since the last packet of the new command
+            bool braking = false;
+
+            unsigned long const targetCommandCode = VolumeUp ? config.VolumeUpCode : config.VolumeDownCode;
+            unsigned long const oppositeCommandCode = VolumeUp ? config.VolumeDownCode : config.VolumeUpCode;
+            static MotorStateId const targetState = VolumeUp ? VOLUME_INCREASING : VOLUME_DECREASING;
+            static MotorStateId const oppositeState = VolumeUp ? REVERSING_TO_DECREASING : REVERSING_TO_INCREASING;
+
+        public:
+            ReversingMotorState(
+                IrReceiver & irReceiver,
+                VolumeMotorConfig const & config,
+                VolumeMotorDriver & motorDriver,
+                MovingMotorState<VolumeUp> & targetMovingState)
+                : irReceiver(irReceiver)
+                , config(config)
+                , motorDriver(motorDriver)
+                , targetMovingState(targetMovingState)
+            { }
+
+            MotorStateId Tick(unsigned long const deltaMicros)
+            {
+                IrPacket packet;
+                bool const received = irReceiver.TryGetPacket(packet);
+                // A change of mind restarts the reversal
+                if (received && !packet.IsRepeat && packet.Code == oppositeCommandCode) return oppositeState;
+                // Repeats continue the new command. The moving state's timeout carries on
+                // from the last of them, so the reversal does not extend the movement
+                if (received && (packet.IsRepeat || packet.Code == targetCommandCode)) microsSinceLastTargetCommand = 0;
+                else microsSinceLastTargetCommand += deltaMicros;
+
+                reversingMicros += deltaMicros;
+                if (reversingMicros >= config.ReversalBrakeMicros + config.ReversalDeadTimeMicros)
+                {
+                    targetMovingState.CarryCommandAge(microsSinceLastTargetCommand);
+                    return targetState;
+                }
+                if (braking && reversingMicros >= config.ReversalBrakeMicros)
+                {
+                    motorDriver.Set(MOTOR_COAST);
+                    braking = false;
+                }
+                return VolumeUp ? REVERSING_TO_INCREASING : REVERSING_TO_DECREASING;
+            }
+
+            void OnEnterState()
+            {
+                reversingMicros = 0;
+                microsSinceLastTargetCommand = 0;
+                braking = config.ReversalBrakeMicros != 0;
+                irReceiver.SetMotorActive(true);
+                motorDriver.Set(braking ? MOTOR_BRAKE : MOTOR_COAST);
+            }
+    };
+
+    class ManualOverrideMotorState final : public State<MotorStateId>
+    {
+        private:
+            IrReceiver & irReceiver;
+            VolumeMotorConfig const & config;
+            VolumeMotorDriver & motorDriver;
+            unsigned long holdOffMicros = 0; // Time since the knob was last turned by hand
+
+        public:
+            ManualOverrideMotorState(
+                IrReceiver & irReceiver,
+                VolumeMotorConfig const & config,
+                VolumeMotorDriver & motorDriver)
+                : irReceiver(irReceiver)
+                , config(config)
+                , motorDriver(motorDriver)
+            { }
+
+            MotorStateId Tick(unsigned long const deltaMicros)
+            {
+                // Discard packets, so that the receiver keeps decoding (and the remote
+                // is ignored) rather than holding onto the first packet of the hold-off
+                irReceiver.TryGetPacket();
+                holdOffMicros += deltaMicros;
+                return holdOffMicros >= config.ManualHoldOffMicros ? IDLE : MANUAL_OVERRIDE;
+            }
+
+            /**
+             * Restart the hold-off, since the knob was turned again
+             */
+            void ExtendHoldOff()
+            {
+                holdOffMicros = 0;
+            }
+
+            void OnEnterState()
+            {
+                holdOffMicros = 0;
+                irReceiver.SetMotorActive(false);
+                // Coast, so that the knob turns freely (see L298Bridge for an exception)
+                motorDriver.Set(MOTOR_COAST);
             }
     };
 
@@ -111,101 +324,271 @@ namespace VolumeMotorUtils
         private:
             IrReceiver & irReceiver;
             VolumeMotorConfig const & config;
+            VolumeMotorDriver & motorDriver;
+            SupplyMonitor & supplyMonitor;
             unsigned long microsSinceLastForwardCommand = 0; // Time since last matching command/repeat packet
+            unsigned long carriedCommandMicros = 0; // Time since the command that led to this state, on entry
+            byte repeatsOnCadence = 0; // Consecutive repeats that arrived on the expected cadence
+            byte missedRepeats = 0; // Repeats bridged since the last matching packet
+            unsigned long movingMicros = 0; // Time since the motor started moving, until soft start completes
+            unsigned long pwmPhaseMicros = 0;
+            byte throttledDuty = FULL_DUTY;
+            bool driving = false; // Whether the motor is driven (rather than coasting) in the current PWM phase
 
             unsigned long const forwardCommandCode = VolumeUp ? config.VolumeUpCode: config.VolumeDownCode;
             unsigned long const reverseCommandCode = VolumeUp ? config.VolumeDownCode : config.VolumeUpCode;
-            int const forwardPin = VolumeUp ? config.VolumeUpPin: config.VolumeDownPin;
-            int const reversePin = VolumeUp ? config.VolumeDownPin : config.VolumeUpPin;
+            static MotorOutput const forwardOutput = VolumeUp ? MOTOR_VOLUME_UP : MOTOR_VOLUME_DOWN;
             static MotorStateId const forwardState = VolumeUp ? VOLUME_INCREASING : VOLUME_DECREASING;
             static MotorStateId const reverseState = VolumeUp ? VOLUME_DECREASING : VOLUME_INCREASING;
+            static MotorStateId const reversingState = VolumeUp ? REVERSING_TO_DECREASING : REVERSING_TO_INCREASING;
+
+            /**
+             * Time-proportion the forward drive according to the soft start ramp
+             * and the supply voltage. The motor coasts (rather than brakes)
+             * during the off part of each period, unless the driver cannot
+             * coast (see L298Bridge)
+             */
+            void Drive(unsigned long const deltaMicros)
+            {
+                if (config.SupplySagMillivolts && supplyMonitor.Poll())
+                {
+                    // Back off gradually while the supply is sagging, and recover
+                    // gradually once it is not, rather than oscillating between extremes
+                    if (supplyMonitor.GetMillivolts() < config.SupplySagMillivolts)
+                    {
+                        if (throttledDuty > MINIMUM_THROTTLED_DUTY) throttledDuty--;
+                    }
+                    else if (throttledDuty < FULL_DUTY) throttledDuty++;
+                }
+
+                byte duty = throttledDuty;
+                if (movingMicros < config.SoftStartMicros)
+                {
+                    movingMicros += deltaMicros;
+                    if (movingMicros < config.SoftStartMicros)
+                    {
+                        byte const softStartDuty = FULL_DUTY * movingMicros / config.SoftStartMicros;
+                        if (softStartDuty < duty) duty = softStartDuty;
+                    }
+                }
+
+                pwmPhaseMicros += deltaMicros;
+                if (pwmPhaseMicros >= PWM_PERIOD_MICROS) pwmPhaseMicros %= PWM_PERIOD_MICROS;
+                bool const drive = pwmPhaseMicros * FULL_DUTY < PWM_PERIOD_MICROS * duty;
+                if (drive != driving)
+                {
+                    motorDriver.Set(drive ? forwardOutput : MOTOR_COAST);
+                    driving = drive;
+                }
+            }
+
+            /**
+             * Track whether repeats are arriving every REPEAT_PERIOD_MICROS
+             * (or a multiple of it, after bridging missed repeats)
+             */
+            void onForwardPacket(bool const isRepeat)
+            {
+                unsigned long const cadenceMicros = microsSinceLastForwardCommand + REPEAT_CADENCE_TOLERANCE_MICROS;
+                bool const onCadence = isRepeat
+                    && cadenceMicros >= REPEAT_PERIOD_MICROS
+                    && cadenceMicros % REPEAT_PERIOD_MICROS <= 2 * REPEAT_CADENCE_TOLERANCE_MICROS;
+                if (!onCadence) repeatsOnCadence = 0;
+                else if (repeatsOnCadence < MINIMUM_CADENCE_REPEATS) repeatsOnCadence++;
+                microsSinceLastForwardCommand = 0;
+                missedRepeats = 0;
+            }
+
+            /**
+             * Called each time the movement timeout (extended by the repeats bridged so far) expires
+             *
+             * @returns True iff. the missed repeat should be bridged
+             */
+            bool bridgeMissedRepeat()
+            {
+                if (missedRepeats >= config.MaxMissedRepeats || repeatsOnCadence < MINIMUM_CADENCE_REPEATS) return false;
+
+                // A released button leaves only motor noise, which cannot fake a frame
+                // start. A repeat lost to a poor demodulator or interference still
+                // starts with its AGC burst, a repeat period after the last repeat
+                unsigned long const microsSinceFrameStart = Hal::Micros() - irReceiver.GetLastFrameStartMicros();
+                if (microsSinceFrameStart >= microsSinceLastForwardCommand) return false;
+                unsigned long const frameStartOffsetMicros = microsSinceLastForwardCommand - microsSinceFrameStart;
+                unsigned long const expectedOffsetMicros = (missedRepeats + 1) * REPEAT_PERIOD_MICROS - REPEAT_DURATION;
+                if (frameStartOffsetMicros + REPEAT_CADENCE_TOLERANCE_MICROS < expectedOffsetMicros
+                    || frameStartOffsetMicros > expectedOffsetMicros + REPEAT_CADENCE_TOLERANCE_MICROS) return false;
+
+                missedRepeats++;
+                return true;
+            }
 
         public:
             MovingMotorState(
                 IrReceiver & irReceiver,
-                VolumeMotorConfig const & config)
+                VolumeMotorConfig const & config,
+                VolumeMotorDriver & motorDriver,
+                SupplyMonitor & supplyMonitor)
                 : irReceiver(irReceiver)
                 , config(config)
+                , motorDriver(motorDriver)
+                , supplyMonitor(supplyMonitor)
             { }
 
-            MotorStateId const Tick(unsigned long const deltaMicros)
+            /**
+             * Start the movement timeout on the next entry from a command received
+             * this long before, rather than from the entry itself
+             */
+            void CarryCommandAge(unsigned long const micros)
+            {
+                carriedCommandMicros = micros;
+            }
+
+            MotorStateId Tick(unsigned long const deltaMicros)
             {
                 IrPacket packet;
-                if (irReceiver.TryGetPacket(packet))
+                bool const received = irReceiver.TryGetPacket(packet);
+                if (received && !packet.IsRepeat && packet.Code == reverseCommandCode)
                 {
-                    if (packet.IsRepeat || packet.Code == forwardCommandCode) microsSinceLastForwardCommand = 0;
-                    else if (packet.Code == reverseCommandCode) return reverseState;
+                    return config.ReversalBrakeMicros || config.ReversalDeadTimeMicros ? reversingState : reverseState;
                 }
+                if (received && (packet.IsRepeat || packet.Code == forwardCommandCode)) onForwardPacket(packet.IsRepeat);
+                // Other codes do not stop the clock
                 else microsSinceLastForwardCommand += deltaMicros;
 
-                return microsSinceLastForwardCommand > config.MovementTimeoutMicros ? BRAKING : forwardState;
+                if (microsSinceLastForwardCommand > config.MovementTimeoutMicros + missedRepeats * REPEAT_PERIOD_MICROS
+                    && !bridgeMissedRepeat()) return BRAKING;
+                Drive(deltaMicros);
+                return forwardState;
             }
 
             void OnEnterState()
             {
-                microsSinceLastForwardCommand = 0;
-                // Setting the reverse pin to low first ensures that no braking occurs
-                digitalWrite(reversePin, LOW);
-                digitalWrite(forwardPin, HIGH);
+                microsSinceLastForwardCommand = carriedCommandMicros;
+                carriedCommandMicros = 0;
+                repeatsOnCadence = 0;
+                missedRepeats = 0;
+                movingMicros = 0;
+                pwmPhaseMicros = 0;
+                throttledDuty = FULL_DUTY;
+                irReceiver.SetMotorActive(true);
+                driving = config.SoftStartMicros == 0;
+                motorDriver.Set(driving ? forwardOutput : MOTOR_COAST);
             }
     };
 
-    class VolumeIncreasingMotorState : public MovingMotorState<true>
+    class VolumeIncreasingMotorState final : public MovingMotorState<true>
     {
         public:
             VolumeIncreasingMotorState(
                 IrReceiver & irReceiver,
-                VolumeMotorConfig const & config)
-                : MovingMotorState(irReceiver, config)
+                VolumeMotorConfig const & config,
+                VolumeMotorDriver & motorDriver,
+                SupplyMonitor & supplyMonitor)
+                : MovingMotorState(irReceiver, config, motorDriver, supplyMonitor)
             { }
     };
 
-    class VolumeDecreasingMotorState : public MovingMotorState<false>
+    class VolumeDecreasingMotorState final : public MovingMotorState<false>
     {
         public:
             VolumeDecreasingMotorState(
                 IrReceiver & irReceiver,
-                VolumeMotorConfig const & config)
-                : MovingMotorState(irReceiver, config)
+                VolumeMotorConfig const & config,
+                VolumeMotorDriver & motorDriver,
+                SupplyMonitor & supplyMonitor)
+                : MovingMotorState(irReceiver, config, motorDriver, supplyMonitor)
             { }
     };
 
-    class VolumeMotorStateMachine : public StateMachine<MotorStateId>
+    class VolumeMotorStateMachine final : public StateMachine<MotorStateId>
     {
         private:
             IrReceiver & irReceiver;
             VolumeMotorConfig const config;
+            VolumeMotorDriver motorDriver;
+            SupplyMonitor supplyMonitor;
+            GradeBlinker statusLed;
             VolumeIncreasingMotorState volumeIncreasingMotorState;
             VolumeDecreasingMotorState volumeDecreasingMotorState;
             BrakingMotorState brakingMotorState;
+            ReversingMotorState<true> reversingToIncreasingMotorState;
+            ReversingMotorState<false> reversingToDecreasingMotorState;
+            ManualOverrideMotorState manualOverrideMotorState;
             IdleMotorState idleMotorState;
+            ManualInput * manualInput = nullptr;
 
         protected:
-            State<MotorStateId> * GetStateInstance(MotorStateId const stateId) const
+            State<MotorStateId> * GetStateInstance(MotorStateId const stateId)
             {
                 switch(stateId)
                 {
                     case VOLUME_INCREASING: return &volumeIncreasingMotorState;
                     case VOLUME_DECREASING: return &volumeDecreasingMotorState;
                     case BRAKING: return &brakingMotorState;
+                    case REVERSING_TO_INCREASING: return &reversingToIncreasingMotorState;
+                    case REVERSING_TO_DECREASING: return &reversingToDecreasingMotorState;
+                    case MANUAL_OVERRIDE: return &manualOverrideMotorState;
                     case IDLE:
                     default:
                         return &idleMotorState;
                 }
             }
 
+            void checkManualInput()
+            {
+                auto const stateId = GetStateId();
+                // Taken even while idle, so that turns made while idle are not acted on later
+                bool const moved = manualInput->TakeManualMovement(
+                    stateId == MANUAL_OVERRIDE ? MOTOR_COAST : motorDriver.GetDrivenOutput());
+                if (!moved || stateId == IDLE) return;
+                if (stateId == MANUAL_OVERRIDE) manualOverrideMotorState.ExtendHoldOff();
+                else SetState(MANUAL_OVERRIDE);
+            }
+
         public:
             VolumeMotorStateMachine(
                 IrReceiver & irReceiver,
                 VolumeMotorConfig const && inConfig) // Called "inConfig" to distinguish it from the member "config" when initialising the states below
                 : StateMachine(IDLE, &idleMotorState)
-                , config(inConfig)
                 , irReceiver(irReceiver)
-                , volumeIncreasingMotorState(irReceiver, config)
-                , volumeDecreasingMotorState(irReceiver, config)
-                , brakingMotorState(irReceiver, config)
-                , idleMotorState(irReceiver, config)
+                , config(inConfig)
+                , motorDriver(MotorDriverConfig { config.VolumeUpPin, config.VolumeDownPin, config.MotorEnablePin, config.MotorDeadTimeMicros })
+                , statusLed(config.StatusLedPin)
+                , volumeIncreasingMotorState(irReceiver, config, motorDriver, supplyMonitor)
+                , volumeDecreasingMotorState(irReceiver, config, motorDriver, supplyMonitor)
+                , brakingMotorState(irReceiver, config, motorDriver)
+                , reversingToIncreasingMotorState(irReceiver, config, motorDriver, volumeIncreasingMotorState)
+                , reversingToDecreasingMotorState(irReceiver, config, motorDriver, volumeDecreasingMotorState)
+                , manualOverrideMotorState(irReceiver, config, motorDriver)
+                , idleMotorState(irReceiver, config, motorDriver, statusLed)
             { }
+
+            /**
+             * Supervise the state machine with the hardware watchdog
+             * If Tick is not called within the timeout, both motor pins are
+             * driven LOW and the MCU is reset. See WatchdogUtils for details
+             */
+            void EnableWatchdog(Hal::WatchdogTimeout const timeout)
+            {
+                WatchdogUtils::Enable(timeout, config.VolumeUpPin, config.VolumeDownPin);
+            }
+
+            /**
+             * Stop the motor whenever the knob is turned by hand, and ignore the
+             * remote for ManualHoldOffMicros afterwards. The input must be attached
+             */
+            void EnableManualOverride(ManualInput & input)
+            {
+                manualInput = &input;
+            }
+
+            void Tick()
+            {
+                // The motor pins were forced LOW, but the loop recovered before the reset
+                if (WatchdogUtils::Pet()) motorDriver.Resync();
+                motorDriver.Tick();
+                if (manualInput) checkManualInput();
+                StateMachine::Tick();
+            }
     };
 }
 
@@ -0,0 +1,109 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include "Hal.h"
+
+/**
+ * Supervises the main loop with the hardware watchdog timer
+ *
+ * If the watchdog is not pet within its timeout, the supervised output
+ * pins are forced LOW, then the MCU is reset when the watchdog times out a
+ * second time. If it is pet in between, the watchdog is re-armed instead.
+ * Each watchdog reset is recorded in persistent storage on the next start
+ */
+namespace WatchdogUtils
+{
+    // Persistent storage address of the (saturating) count of watchdog timeouts
+    unsigned int const RESET_COUNT_ADDRESS = 0;
+
+    inline HAL_THREAD_LOCAL bool enabled = false;
+    inline HAL_THREAD_LOCAL Hal::WatchdogTimeout enabledTimeout;
+    inline HAL_THREAD_LOCAL int safePinA;
+    inline HAL_THREAD_LOCAL int safePinB;
+    // Set inside the interrupt context on the first timeout
+    inline HAL_THREAD_LOCAL volatile bool timedOut = false;
+
+    // The count is stored inverted so that erased EEPROM (0xFF) reads as zero
+    void WriteResetCount(uint8_t const count)
+    {
+        Hal::UpdatePersistentByte(RESET_COUNT_ADDRESS, static_cast<uint8_t>(~count));
+    }
+
+    /**
+     * @returns The number of times the watchdog has fired (saturates at 255)
+     */
+    uint8_t GetResetCount()
+    {
+        return ~Hal::ReadPersistentByte(RESET_COUNT_ADDRESS);
+    }
+
+    void ClearResetCount()
+    {
+        WriteResetCount(0);
+    }
+
+    void OnTimeout()
+    {
+        // Stop driving the motor, rather than driving it into an end stop
+        Hal::WritePin(safePinA, Hal::PIN_LOW);
+        Hal::WritePin(safePinB, Hal::PIN_LOW);
+        timedOut = true;
+    }
+
+    /**
+     * Enable the watchdog, and count the last reset if the watchdog caused it.
+     * Call once, from setup()
+     *
+     * @param pinA, pinB Output pins to drive LOW when the watchdog fires
+     */
+    void Enable(Hal::WatchdogTimeout const timeout, int const pinA, int const pinB)
+    {
+        if (Hal::TakeWatchdogReset())
+        {
+            auto const count = GetResetCount();
+            if (count < 255) WriteResetCount(count + 1);
+        }
+        safePinA = pinA;
+        safePinB = pinB;
+        enabledTimeout = timeout;
+        enabled = true;
+        timedOut = false;
+        Hal::EnableWatchdog(timeout, OnTimeout);
+    }
+
+    /**
+     * Must be called more frequently than the watchdog timeout
+     * On AVR, a single instruction plus a test of timedOut
+     *
+     * @returns True iff. the watchdog timed out (forcing the safe pins LOW)
+     * since the last call, without resetting the MCU. The hardware disarms
+     * the timeout interrupt when it runs, so it is re-armed here
+     */
+    inline bool Pet()
+    {
+        Hal::PetWatchdog();
+        if (!timedOut) return false;
+        timedOut = false;
+        Hal::EnableWatchdog(enabledTimeout, OnTimeout);
+        return true;
+    }
+
+    /**
+     * Stop the watchdog (if enabled) while the MCU is intentionally
+     * halted, such as during power-down sleep
+     */
+    void Suspend()
+    {
+        if (enabled) Hal::DisableWatchdog();
+    }
+
+    /**
+     * Restart the watchdog (if enabled) after a call to Suspend
+     */
+    void Resume()
+    {
+        if (enabled) Hal::EnableWatchdog(enabledTimeout, OnTimeout);
+    }
+}
+
+#endif //WATCHDOG_H
\ No newline at end of file
@@ -0,0 +1,110 @@
+/**
+ * Compares decoding throughput of per-edge StateMachine::Tick
+ * (as done by the pin interrupt) against the DecodePackets batch loop,
+ * and checks that both decode the same sequence of codes and repeats,
+ * with and without the noise-tolerant profile
+ *
+ * DecodePackets measured 1.9x the per-edge rate (89M to 165M edges/s) on
+ * a desktop x86-64 with GCC -O2, well short of the order of magnitude that
+ * was hoped for: per-edge ticking is already cheap on the host, and both
+ * loops take the same data-dependent branches for each interval. Only the
+ * vectorised DecodePacketsBulk (see BulkDecodeBenchmark) does much better
+ *
+ * Build and run on the host, from the repository root:
+ *   g++ -std=gnu++17 -O2 -Wall -Wextra -DHAL_HOST -I. benchmarks/BatchDecodeBenchmark.cpp -o BatchDecodeBenchmark
+ *   ./BatchDecodeBenchmark
+ */
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+#include "BatchDecoder.h"
+#include "PerEdgeDecoder.h"
+
+using namespace IrReceiverUtils;
+using namespace PerEdgeDecoderUtils;
+
+namespace
+{
+    size_t const FRAME_COUNT = 200000;
+    int const ITERATIONS = 20;
+
+    /**
+     * Signal-fall intervals for a code followed by three repeats,
+     * with some timing jitter, repeated FRAME_COUNT times
+     */
+    std::vector<uint32_t> BuildCorpus()
+    {
+        std::vector<uint32_t> intervals;
+        uint32_t jitterSeed = 1;
+        auto jitter = [&jitterSeed]()
+        {
+            jitterSeed = jitterSeed * 1103515245 + 12345;
+            return static_cast<int>((jitterSeed >> 16) % 101) - 50;
+        };
+        for (size_t frame = 0; frame < FRAME_COUNT; frame++)
+        {
+            unsigned long const code = 0xFF000000UL | (frame * 2654435761UL & 0xFFFFFFUL);
+            intervals.push_back(40000);
+            intervals.push_back(AGC_DURATION + jitter());
+            for (byte bitIndex = BITS_PER_CODE; bitIndex > 0; bitIndex--)
+            {
+                bool const one = (code >> (bitIndex - 1)) & 1UL;
+                intervals.push_back((one ? ONE_DURATION : ZERO_DURATION) + jitter());
+            }
+            for (int repeat = 0; repeat < 3; repeat++)
+            {
+                intervals.push_back(96000);
+                intervals.push_back(REPEAT_DURATION + jitter());
+            }
+        }
+        return intervals;
+    }
+
+    template <class TDecode> double EdgesPerSecond(size_t const edgeCount, TDecode decode)
+    {
+        auto const start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ITERATIONS; i++) decode();
+        std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+        return edgeCount * ITERATIONS / elapsed.count();
+    }
+}
+
+int main()
+{
+    auto const intervals = BuildCorpus();
+    std::vector<IrPacket> packets(intervals.size());
+    size_t perEdgePackets = 0;
+    size_t batchPackets = 0;
+
+    auto const perEdgeRate = EdgesPerSecond(intervals.size(), [&]()
+    {
+        PerEdgeDecoder decoder;
+        IrPacket packet;
+        perEdgePackets = 0;
+        for (auto const interval : intervals)
+        {
+            decoder.OnInterval(interval);
+            if (decoder.TryGetPacket(packet)) perEdgePackets++;
+        }
+    });
+
+    auto const batchRate = EdgesPerSecond(intervals.size(), [&]()
+    {
+        BatchDecodeState state;
+        batchPackets = DecodePackets(intervals.data(), intervals.size(), packets.data(), packets.size(), state);
+    });
+
+    printf("Edges: %zu, packets: %zu (per-edge) / %zu (batch)\n", intervals.size(), perEdgePackets, batchPackets);
+    printf("Per-edge Tick: %.1f M edges/s\n", perEdgeRate / 1e6);
+    printf("DecodePackets: %.1f M edges/s (%.1fx)\n", batchRate / 1e6, batchRate / perEdgeRate);
+
+    bool same = true;
+    for (bool const noisy : { false, true })
+    {
+        BatchDecodeState state;
+        auto const count = DecodePackets(intervals.data(), intervals.size(), packets.data(), packets.size(), state, noisy);
+        same = SamePackets(noisy ? "DecodePackets (noisy)" : "DecodePackets", DecodePerEdge(intervals, noisy), packets.data(), count) && same;
+    }
+    printf(same ? "Packet sequences match\n" : "Packet sequences differ\n");
+    return same ? 0 : 1;
+}
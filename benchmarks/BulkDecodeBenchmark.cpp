@@ -0,0 +1,209 @@
+/**
+ * Checks that DecodePacketsBulk produces identical results to the per-edge
+ * decoder (and to DecodePackets, across buffer splits) on a randomised corpus,
+ * including intervals on either side of the window edges and intervals too
+ * long for the 16 bit deltas that the receiver saturates them to, then
+ * compares their throughput
+ *
+ * Build and run on the host, from the repository root:
+ *   g++ -std=gnu++17 -O2 -mavx2 -Wall -Wextra -DHAL_HOST -I. benchmarks/BulkDecodeBenchmark.cpp -o BulkDecodeBenchmark
+ *   ./BulkDecodeBenchmark
+ * Omit -mavx2 to measure the SSE2 path. Exits with SKIPPED_EXIT_CODE if built
+ * with -mavx2 for a CPU without AVX2
+ */
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <vector>
+#include "BulkDecoder.h"
+#include "PerEdgeDecoder.h"
+
+using namespace IrReceiverUtils;
+using namespace PerEdgeDecoderUtils;
+
+namespace
+{
+    size_t const FRAME_COUNT = 200000;
+    int const ITERATIONS = 20;
+    // As used by automake, and set as the ctest SKIP_RETURN_CODE
+    int const SKIPPED_EXIT_CODE = 77;
+
+    // Offsets from a window's centre, just inside, on and just outside its edges
+    int const EDGE_OFFSETS[] =
+    {
+        -static_cast<int>(HALF_WINDOW) - 1, -static_cast<int>(HALF_WINDOW), -static_cast<int>(HALF_WINDOW) + 1,
+        static_cast<int>(HALF_WINDOW) - 1, static_cast<int>(HALF_WINDOW), static_cast<int>(HALF_WINDOW) + 1
+    };
+
+    // Long intervals that alias a window once truncated to 16 or 31 bits, and the extremes
+    uint32_t const SATURATED_INTERVALS[] =
+    {
+        0xFFFFUL, 0x10000UL, 0x10000UL + ZERO_DURATION, 0x10000UL + ONE_DURATION,
+        0x10000UL + REPEAT_DURATION, 0x10000UL + AGC_DURATION, 0x80000000UL + ZERO_DURATION,
+        0x80000000UL + AGC_DURATION, 0x7FFFFFFFUL, 0xFFFFFFFFUL
+    };
+
+    /**
+     * Codes and repeats with timing jitter, some of it on the window edges,
+     * interspersed with noise bursts, saturated intervals and truncated codes
+     */
+    std::vector<uint32_t> BuildCorpus()
+    {
+        std::mt19937 random(1);
+        std::uniform_int_distribution<int> inWindow(-static_cast<int>(HALF_WINDOW) + 10, static_cast<int>(HALF_WINDOW) - 10);
+        std::uniform_int_distribution<size_t> edgeOffset(0, sizeof(EDGE_OFFSETS) / sizeof(EDGE_OFFSETS[0]) - 1);
+        std::uniform_int_distribution<size_t> saturated(0, sizeof(SATURATED_INTERVALS) / sizeof(SATURATED_INTERVALS[0]) - 1);
+        std::uniform_int_distribution<uint32_t> noise(0, 6000);
+        std::uniform_int_distribution<int> percent(0, 99);
+        auto const jitter = [&]()
+        {
+            return percent(random) < 2 ? EDGE_OFFSETS[edgeOffset(random)] : inWindow(random);
+        };
+        std::vector<uint32_t> intervals;
+        for (size_t frame = 0; frame < FRAME_COUNT; frame++)
+        {
+            intervals.push_back(40000);
+            int const kind = percent(random);
+            if (kind < 5)
+            {
+                for (int i = 0; i < 10; i++) intervals.push_back(noise(random));
+                continue;
+            }
+            if (kind < 8)
+            {
+                for (int i = 0; i < 4; i++) intervals.push_back(SATURATED_INTERVALS[saturated(random)]);
+                continue;
+            }
+            intervals.push_back(AGC_DURATION + jitter());
+            unsigned long const code = random();
+            byte const bits = percent(random) < 5 ? BITS_PER_CODE / 2 : BITS_PER_CODE;
+            for (byte bitIndex = BITS_PER_CODE; bitIndex > BITS_PER_CODE - bits; bitIndex--)
+            {
+                bool const one = (code >> (bitIndex - 1)) & 1UL;
+                intervals.push_back((one ? ONE_DURATION : ZERO_DURATION) + jitter());
+            }
+            for (int repeat = percent(random) % 4; repeat > 0; repeat--)
+            {
+                intervals.push_back(96000);
+                intervals.push_back(REPEAT_DURATION + jitter());
+            }
+        }
+        return intervals;
+    }
+
+    bool Equal(std::vector<IrPacket> const & expected, std::vector<IrPacket> const & actual)
+    {
+        if (expected.size() != actual.size()) return false;
+        for (size_t i = 0; i < expected.size(); i++)
+        {
+            if (expected[i].IsRepeat != actual[i].IsRepeat || expected[i].Code != actual[i].Code) return false;
+        }
+        return true;
+    }
+
+    template <class TDecode> std::vector<IrPacket> DecodeInChunks(
+        std::vector<uint32_t> const & intervals,
+        size_t const chunkSize,
+        size_t const maxPackets,
+        TDecode decode)
+    {
+        std::vector<IrPacket> packets(maxPackets);
+        BatchDecodeState state;
+        size_t packetCount = 0;
+        for (size_t start = 0; start < intervals.size() && packetCount < maxPackets; start += chunkSize)
+        {
+            size_t const count = start + chunkSize < intervals.size() ? chunkSize : intervals.size() - start;
+            packetCount += decode(intervals.data() + start, count, packets.data() + packetCount, maxPackets - packetCount, state);
+        }
+        packets.resize(packetCount);
+        return packets;
+    }
+
+    size_t ReferenceDecode(uint32_t const * intervals, size_t count, IrPacket * out, size_t max, BatchDecodeState & state)
+    {
+        return DecodePackets(intervals, count, out, max, state);
+    }
+
+    size_t BulkDecode(uint32_t const * intervals, size_t count, IrPacket * out, size_t max, BatchDecodeState & state)
+    {
+        return DecodePacketsBulk(intervals, count, out, max, state);
+    }
+}
+
+int main()
+{
+#if defined(__AVX2__)
+    if (!__builtin_cpu_supports("avx2"))
+    {
+        printf("Skipped: built for AVX2, which this CPU does not support\n");
+        return SKIPPED_EXIT_CODE;
+    }
+#endif
+    auto const intervals = BuildCorpus();
+
+    // The per-edge decoder, as the pin interrupt ticks it, is the reference
+    auto const perEdge = DecodePerEdge(intervals, /*noisy:*/false);
+    {
+        auto const bulk = DecodeInChunks(intervals, intervals.size(), intervals.size(), BulkDecode);
+        if (!SamePackets("DecodePacketsBulk", perEdge, bulk.data(), bulk.size())) return 1;
+    }
+
+    // Packets split across buffers and full output buffers, against DecodePackets,
+    // which is checked against the per-edge decoder by BatchDecodeBenchmark
+    size_t const chunkSizes[] = { intervals.size(), 1, 7, 33, 4096, 5000 };
+    size_t const packetLimits[] = { intervals.size(), 1000, 1 };
+    for (auto const chunkSize : chunkSizes)
+    {
+        for (auto const maxPackets : packetLimits)
+        {
+            auto const expected = DecodeInChunks(intervals, chunkSize, maxPackets, ReferenceDecode);
+            auto const actual = DecodeInChunks(intervals, chunkSize, maxPackets, BulkDecode);
+            if (!Equal(expected, actual))
+            {
+                printf("Mismatch with chunk size %zu and packet limit %zu\n", chunkSize, maxPackets);
+                return 1;
+            }
+        }
+    }
+
+    std::vector<IrPacket> packets(intervals.size());
+    size_t packetCount = 0;
+    auto const time = [&](auto decode)
+    {
+        auto const start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ITERATIONS; i++)
+        {
+            BatchDecodeState state;
+            packetCount = decode(intervals.data(), intervals.size(), packets.data(), packets.size(), state);
+        }
+        std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+        return intervals.size() * ITERATIONS / elapsed.count();
+    };
+    auto const perEdgeRate = time([&](uint32_t const *, size_t, IrPacket *, size_t, BatchDecodeState &)
+    {
+        PerEdgeDecoder decoder;
+        IrPacket packet;
+        size_t count = 0;
+        for (auto const interval : intervals)
+        {
+            decoder.OnInterval(interval);
+            if (decoder.TryGetPacket(packet)) count++;
+        }
+        return count;
+    });
+    auto const referenceRate = time(ReferenceDecode);
+    auto const bulkRate = time(BulkDecode);
+
+#if defined(__AVX2__)
+    char const * const path = "AVX2";
+#elif defined(__SSE2__)
+    char const * const path = "SSE2";
+#else
+    char const * const path = "scalar";
+#endif
+    printf("Edges: %zu, packets: %zu, results identical\n", intervals.size(), packetCount);
+    printf("Per-edge Tick: %.1f M edges/s\n", perEdgeRate / 1e6);
+    printf("DecodePackets: %.1f M edges/s (%.1fx)\n", referenceRate / 1e6, referenceRate / perEdgeRate);
+    printf("DecodePacketsBulk (%s): %.1f M edges/s (%.1fx)\n", path, bulkRate / 1e6, bulkRate / perEdgeRate);
+    return 0;
+}
@@ -0,0 +1,225 @@
+/**
+ * Compares how many codes and repeats the receiver captures with and without
+ * the noise-tolerant profile (see IrReceiver::SetMotorActive), over a range
+ * of motor noise rates and timing jitter, and how many packets it decodes
+ * that were never sent
+ *
+ * Motor noise is simulated as signal falls at random (Poisson) times, other
+ * than during a burst, when the signal is already low. A packet only counts as
+ * captured if it is decoded on the last signal fall of the frame that sent it.
+ * Any other is spurious, even if it happens to arrive during a frame
+ *
+ * Fails if the noisy profile captures fewer repeats than the standard one in
+ * any noisy condition, since repeats are what keep the motor moving, or if it
+ * lets through spurious repeats more often than once per movement timeout,
+ * since those would keep the motor moving after the button is released
+ *
+ * Build and run on the host, from the repository root:
+ *   g++ -std=gnu++17 -O2 -Wall -Wextra -DHAL_HOST -I. benchmarks/CaptureRateBenchmark.cpp -o CaptureRateBenchmark
+ *   ./CaptureRateBenchmark
+ */
+#include <random>
+#include <utility>
+#include <stdio.h>
+#include <vector>
+#include "PerEdgeDecoder.h"
+
+using namespace IrReceiverUtils;
+using namespace PerEdgeDecoderUtils;
+
+namespace
+{
+    int const HOLDS = 20000;
+    int const REPEATS_PER_HOLD = 3;
+    unsigned long const GAP_BEFORE_CODE_MICROS = 40000UL;
+    unsigned long const GAP_BEFORE_REPEAT_MICROS = 96000UL;
+    unsigned long const AGC_MARK_MICROS = 9000UL;
+    unsigned long const BIT_MARK_MICROS = 560UL;
+    // See VolumeMotorConfig::MovementTimeoutMicros in MotorisedVolumeKnob.ino
+    unsigned long const MOVEMENT_TIMEOUT_MICROS = 120UL * 1000UL;
+
+    double const NOISE_FALLS_PER_MILLI[] = { 0.0, 0.05, 0.25, 1.0 };
+    double const JITTER_MICROS[] = { 15.0, 30.0 };
+
+    struct Fall
+    {
+        unsigned long Micros;
+        unsigned long MarkMicros; // Length of the burst that ended with this fall
+    };
+
+    struct DecodedPacket
+    {
+        IrPacket Packet;
+        bool OnLastFall; // Decoded on the last signal fall of the frame sent
+    };
+
+    struct CaptureCounts
+    {
+        unsigned long CodesSent = 0;
+        unsigned long CodesCaptured = 0;
+        unsigned long RepeatsSent = 0;
+        unsigned long RepeatsCaptured = 0;
+        // Packets decoded that were not sent
+        unsigned long SpuriousCodes = 0;
+        unsigned long SpuriousRepeats = 0;
+        unsigned long SimulatedMicros = 0;
+
+        double CodeRate() const
+        {
+            return 100.0 * CodesCaptured / CodesSent;
+        }
+
+        double RepeatRate() const
+        {
+            return 100.0 * RepeatsCaptured / RepeatsSent;
+        }
+
+        /**
+         * Mean simulated time between spurious repeats, in milliseconds
+         */
+        double SpuriousRepeatIntervalMillis() const
+        {
+            return SpuriousRepeats ? SimulatedMicros / 1000.0 / SpuriousRepeats : SimulatedMicros / 1000.0;
+        }
+    };
+
+    class Channel
+    {
+        private:
+            std::mt19937 random { 1 };
+            std::normal_distribution<double> jitter;
+            std::exponential_distribution<double> noiseInterval;
+            double const noiseFallsPerMilli;
+            PerEdgeDecoder decoder;
+            unsigned long micros = 0; // Time of the last signal fall sent
+            unsigned long nextNoiseMicros = 0;
+            unsigned long lastFallMicros = 0; // Time of the last signal fall, including noise
+
+            /**
+             * Signal falls for a frame, starting after the given gap, each jittered
+             */
+            std::vector<Fall> frameFalls(unsigned long const gapMicros, std::vector<unsigned long> const & intervalsMicros)
+            {
+                std::vector<Fall> falls;
+                micros += gapMicros;
+                falls.push_back(Fall { micros, AGC_MARK_MICROS });
+                for (auto const intervalMicros : intervalsMicros)
+                {
+                    micros += static_cast<unsigned long>(intervalMicros + jitter(random));
+                    falls.push_back(Fall { micros, BIT_MARK_MICROS });
+                }
+                return falls;
+            }
+
+            /**
+             * Feed a frame's signal falls, and those of the noise up to its end, to the decoder
+             *
+             * @returns The packets decoded
+             */
+            std::vector<DecodedPacket> transmit(std::vector<Fall> const & falls)
+            {
+                std::vector<DecodedPacket> packets;
+                auto const signalFall = [&](unsigned long const fallMicros, bool const lastFall)
+                {
+                    decoder.OnInterval(fallMicros - lastFallMicros);
+                    lastFallMicros = fallMicros;
+                    IrPacket packet;
+                    if (decoder.TryGetPacket(packet)) packets.push_back(DecodedPacket { packet, lastFall });
+                };
+                for (size_t i = 0; i < falls.size(); i++)
+                {
+                    auto const fall = falls[i];
+                    while (noiseFallsPerMilli > 0 && nextNoiseMicros < fall.Micros)
+                    {
+                        // The signal is already low during a burst
+                        if (nextNoiseMicros < fall.Micros - fall.MarkMicros) signalFall(nextNoiseMicros, false);
+                        nextNoiseMicros += static_cast<unsigned long>(noiseInterval(random)) + 1;
+                    }
+                    signalFall(fall.Micros, i + 1 == falls.size());
+                }
+                return packets;
+            }
+
+        public:
+            Channel(bool const noisy, double const noiseFallsPerMilli, double const jitterMicros)
+                : jitter(0.0, jitterMicros)
+                , noiseInterval(noiseFallsPerMilli > 0 ? noiseFallsPerMilli / 1000.0 : 1.0)
+                , noiseFallsPerMilli(noiseFallsPerMilli)
+            {
+                decoder.SetMotorActive(noisy);
+            }
+
+            void SendHold(unsigned long const code, CaptureCounts & counts)
+            {
+                std::vector<unsigned long> intervals { AGC_DURATION };
+                for (byte bitIndex = BITS_PER_CODE; bitIndex > 0; bitIndex--)
+                {
+                    intervals.push_back((code >> (bitIndex - 1)) & 1UL ? ONE_DURATION : ZERO_DURATION);
+                }
+                unsigned long const startMicros = micros;
+                bool captured = false;
+                for (auto const decoded : transmit(frameFalls(GAP_BEFORE_CODE_MICROS, intervals)))
+                {
+                    if (decoded.OnLastFall && !decoded.Packet.IsRepeat && decoded.Packet.Code == code) captured = true;
+                    else if (decoded.Packet.IsRepeat) counts.SpuriousRepeats++;
+                    else counts.SpuriousCodes++;
+                }
+                counts.CodesSent++;
+                counts.CodesCaptured += captured;
+
+                for (int repeat = 0; repeat < REPEATS_PER_HOLD; repeat++)
+                {
+                    captured = false;
+                    for (auto const decoded : transmit(frameFalls(GAP_BEFORE_REPEAT_MICROS, { REPEAT_DURATION })))
+                    {
+                        if (decoded.OnLastFall && decoded.Packet.IsRepeat) captured = true;
+                        else if (decoded.Packet.IsRepeat) counts.SpuriousRepeats++;
+                        else counts.SpuriousCodes++;
+                    }
+                    counts.RepeatsSent++;
+                    counts.RepeatsCaptured += captured;
+                }
+                counts.SimulatedMicros += micros - startMicros;
+            }
+    };
+
+    CaptureCounts measure(bool const noisy, double const noiseFallsPerMilli, double const jitterMicros)
+    {
+        Channel channel(noisy, noiseFallsPerMilli, jitterMicros);
+        std::mt19937 codes(2);
+        CaptureCounts counts;
+        for (int hold = 0; hold < HOLDS; hold++) channel.SendHold(codes(), counts);
+        return counts;
+    }
+}
+
+int main()
+{
+    bool regressed = false;
+    printf("Noise/ms  Jitter(us)  Profile   Codes(%%)  Repeats(%%)  Spurious codes  Spurious repeats  ms per spurious repeat\n");
+    for (auto const jitterMicros : JITTER_MICROS)
+    {
+        for (auto const noiseFallsPerMilli : NOISE_FALLS_PER_MILLI)
+        {
+            auto const standard = measure(false, noiseFallsPerMilli, jitterMicros);
+            auto const noisy = measure(true, noiseFallsPerMilli, jitterMicros);
+            for (auto const & [name, counts] : { std::pair { "standard", standard }, std::pair { "noisy", noisy } })
+            {
+                printf("%8.2f  %10.0f  %-8s  %8.1f  %10.1f  %14lu  %16lu  %21.0f\n",
+                    noiseFallsPerMilli, jitterMicros, name, counts.CodeRate(), counts.RepeatRate(),
+                    counts.SpuriousCodes, counts.SpuriousRepeats, counts.SpuriousRepeatIntervalMillis());
+            }
+            if (noiseFallsPerMilli > 0 && noisy.RepeatsCaptured < standard.RepeatsCaptured)
+            {
+                printf("The noisy profile captured fewer repeats than the standard profile\n");
+                regressed = true;
+            }
+            if (noisy.SpuriousRepeatIntervalMillis() * 1000.0 < MOVEMENT_TIMEOUT_MICROS)
+            {
+                printf("The noisy profile let through a spurious repeat more often than once per movement timeout\n");
+                regressed = true;
+            }
+        }
+    }
+    return regressed ? 1 : 0;
+}
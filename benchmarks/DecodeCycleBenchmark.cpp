@@ -0,0 +1,172 @@
+/**
+ * Counts the CPU cycles that the receiver's pin interrupt spends decoding
+ * each signal fall, with 32 bit (unsigned long) intervals and with the
+ * 16 bit (DecodeMicros) intervals that the receiver uses, and prints
+ * them to the serial port at 115200 baud, along with the cycles spent
+ * timing each signal fall with MicrosClock and with CaptureTimerClock
+ *
+ * Runs on an AVR based Arduino. Built as build/firmware/DecodeCycleBenchmark.hex
+ * by the CMake build when the firmware is (see README.md). Cycles are
+ * counted with Timer1, so reading the clock is not included in the decode
+ * cycles, since it costs the same for both. CaptureTimerClock is not started,
+ * since Timer1 is counting cycles, but reading it costs the same either way
+ */
+#include "IrReceiver.h"
+
+using namespace IrReceiverUtils;
+
+namespace
+{
+    unsigned long const CODE = 0xFFA857;
+    int const FRAMES = 50;
+    int const REPEATS_PER_FRAME = 3;
+
+    /**
+     * Decodes through IrPacketDecoder::OnSignalFall, as InputPinIrReceiver
+     * does in its interrupt, but is given the time of each signal fall,
+     * rather than reading it
+     */
+    template <class TDeltaMicros> class CycleCountedDecoder final : public IrPacketDecoder<MicrosClock, TDeltaMicros>
+    {
+        private:
+            volatile unsigned long lastFrameStartMicros = 0;
+
+        public:
+            __attribute__((noinline)) void CountedSignalFall(unsigned long const currentMicros)
+            {
+                if (this->OnSignalFall(currentMicros)) lastFrameStartMicros = currentMicros;
+            }
+
+            bool PowerDownUntilSignal()
+            {
+                return false;
+            }
+
+            unsigned long GetLastFrameStartMicros() const
+            {
+                return lastFrameStartMicros;
+            }
+    };
+
+    struct CycleCount
+    {
+        unsigned long Cycles;
+        unsigned long SignalFalls;
+    };
+
+    unsigned int overheadCycles = 0;
+
+    uint16_t readCycles()
+    {
+        return TCNT1;
+    }
+
+    template <class TDeltaMicros> void countSignalFall(
+        CycleCountedDecoder<TDeltaMicros> & decoder,
+        unsigned long const currentMicros,
+        CycleCount & count)
+    {
+        noInterrupts();
+        uint16_t const start = readCycles();
+        decoder.CountedSignalFall(currentMicros);
+        uint16_t const end = readCycles();
+        interrupts();
+        count.Cycles += static_cast<uint16_t>(end - start) - overheadCycles;
+        count.SignalFalls++;
+    }
+
+    /**
+     * A code followed by repeats, FRAMES times, with the gaps in between
+     */
+    template <class TDeltaMicros> CycleCount countDecodeCycles(bool const motorActive)
+    {
+        CycleCountedDecoder<TDeltaMicros> decoder;
+        decoder.SetMotorActive(motorActive);
+        CycleCount count = { 0, 0 };
+        IrPacket packet;
+        unsigned long micros = 0;
+        for (int frame = 0; frame < FRAMES; frame++)
+        {
+            micros += 40000UL;
+            countSignalFall(decoder, micros, count);
+            micros += AGC_DURATION;
+            countSignalFall(decoder, micros, count);
+            for (byte bitIndex = BITS_PER_CODE; bitIndex > 0; bitIndex--)
+            {
+                micros += (CODE >> (bitIndex - 1)) & 1UL ? ONE_DURATION : ZERO_DURATION;
+                countSignalFall(decoder, micros, count);
+            }
+            decoder.TryGetPacket(packet);
+            for (int repeat = 0; repeat < REPEATS_PER_FRAME; repeat++)
+            {
+                micros += 96000UL;
+                countSignalFall(decoder, micros, count);
+                micros += REPEAT_DURATION;
+                countSignalFall(decoder, micros, count);
+                decoder.TryGetPacket(packet);
+            }
+        }
+        return count;
+    }
+
+    volatile unsigned long elapsedSink = 0;
+
+    /**
+     * Times signal falls as InputPinIrReceiver does: reading the clock, and the
+     * interval since the last reading
+     */
+    template <class TClock> CycleCount countClockCycles()
+    {
+        CycleCount count = { 0, 0 };
+        auto lastTime = TClock::Now();
+        for (int signalFall = 0; signalFall < FRAMES; signalFall++)
+        {
+            noInterrupts();
+            uint16_t const start = readCycles();
+            auto const currentTime = TClock::Now();
+            auto const elapsedMicros = TClock::ElapsedMicros(lastTime, currentTime);
+            uint16_t const end = readCycles();
+            interrupts();
+            elapsedSink += elapsedMicros;
+            lastTime = currentTime;
+            count.Cycles += static_cast<uint16_t>(end - start) - overheadCycles;
+            count.SignalFalls++;
+        }
+        return count;
+    }
+
+    void printCycles(char const * const name, CycleCount const count)
+    {
+        Serial.print(name);
+        Serial.print(F(": "));
+        Serial.print(static_cast<double>(count.Cycles) / count.SignalFalls, 1);
+        Serial.println(F(" cycles per signal fall"));
+    }
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    // Timer1 counts CPU cycles
+    TCCR1A = 0;
+    TCCR1B = bit(CS10);
+
+    noInterrupts();
+    uint16_t const start = readCycles();
+    uint16_t const end = readCycles();
+    interrupts();
+    overheadCycles = end - start;
+
+    for (byte pass = 0; pass < 2; pass++)
+    {
+        bool const motorActive = pass == 1;
+        Serial.println(motorActive ? F("Motor active (noisy windows, glitch filter)") : F("Motor idle"));
+        printCycles("  32 bit decode", countDecodeCycles<unsigned long>(motorActive));
+        printCycles("  16 bit decode", countDecodeCycles<DecodeMicros>(motorActive));
+    }
+    Serial.println(F("Timing"));
+    printCycles("  MicrosClock", countClockCycles<MicrosClock>());
+    printCycles("  CaptureTimerClock", countClockCycles<CaptureTimerClock>());
+}
+
+void loop() { }
@@ -0,0 +1,93 @@
+#ifndef PER_EDGE_DECODER_H
+#define PER_EDGE_DECODER_H
+
+#include <stdio.h>
+#include <vector>
+#include "IrReceiver.h"
+
+/**
+ * The reference that the batch and bulk decoders are checked against
+ */
+namespace PerEdgeDecoderUtils
+{
+    using namespace IrReceiverUtils;
+
+    /**
+     * Decodes each signal fall through IrPacketDecoder::OnSignalFall, as
+     * InputPinIrReceiver does in its interrupt, but is given the interval
+     * since the previous signal fall rather than timing it
+     */
+    class PerEdgeDecoder final : public IrPacketDecoder<>
+    {
+        private:
+            unsigned long signalFallMicros = 0;
+
+        public:
+            void OnInterval(unsigned long const intervalMicros)
+            {
+                signalFallMicros += intervalMicros;
+                OnSignalFall(signalFallMicros);
+            }
+
+            bool PowerDownUntilSignal()
+            {
+                return false;
+            }
+
+            unsigned long GetLastFrameStartMicros() const
+            {
+                return 0;
+            }
+    };
+
+    /**
+     * Decode intervals one signal fall at a time, reading each packet as soon as it arrives
+     *
+     * @param noisy Whether to use the noise-tolerant profile (see IrReceiver::SetMotorActive)
+     */
+    template <class TInterval> std::vector<IrPacket> DecodePerEdge(std::vector<TInterval> const & intervals, bool const noisy)
+    {
+        PerEdgeDecoder decoder;
+        decoder.SetMotorActive(noisy);
+        std::vector<IrPacket> packets;
+        IrPacket packet;
+        for (auto const interval : intervals)
+        {
+            decoder.OnInterval(interval);
+            // Repeats carry no code. Cleared, so that packets compare alike
+            if (decoder.TryGetPacket(packet)) packets.push_back(IrPacket { packet.IsRepeat, packet.IsRepeat ? 0 : packet.Code });
+        }
+        return packets;
+    }
+
+    /**
+     * Compare two packet sequences element by element, printing the first difference
+     *
+     * @returns True iff. they are identical
+     */
+    bool SamePackets(
+        char const * const name,
+        std::vector<IrPacket> const & expected,
+        IrPacket const * const actual,
+        size_t const actualCount)
+    {
+        size_t const count = expected.size() < actualCount ? expected.size() : actualCount;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (expected[i].IsRepeat == actual[i].IsRepeat && expected[i].Code == actual[i].Code) continue;
+            printf("%s: packet %zu is %s 0x%08lX, expected %s 0x%08lX\n",
+                name,
+                i,
+                actual[i].IsRepeat ? "repeat" : "code",
+                actual[i].Code,
+                expected[i].IsRepeat ? "repeat" : "code",
+                expected[i].Code);
+            return false;
+        }
+        if (expected.size() == actualCount) return true;
+        printf("%s: %zu packets, expected %zu\n", name, actualCount, expected.size());
+        return false;
+    }
+}
+
+#endif //PER_EDGE_DECODER_H
\ No newline at end of file
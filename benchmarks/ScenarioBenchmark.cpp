@@ -0,0 +1,222 @@
+/**
+ * Runs random remote, garbled frame and manual override scenarios through the motor
+ * state machine in simulated time, using the scripted receiver and virtual
+ * time driver, and reports the scenario rate and which state transitions
+ * the scenarios covered. Fails if any of the transitions that the scenarios
+ * are expected to cover is never taken (MotorTransitionsTest scripts every
+ * transition, and checks the motor outputs)
+ *
+ * Build and run on the host, from the repository root:
+ *   g++ -std=gnu++17 -O2 -Wall -Wextra -DHAL_HOST -I. benchmarks/ScenarioBenchmark.cpp -o ScenarioBenchmark
+ *   ./ScenarioBenchmark [scenarios]
+ */
+#include <chrono>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Simulation.h"
+#include "VolumeMotorStateMachine.h"
+
+using namespace SimulationUtils;
+using namespace VolumeMotorUtils;
+
+namespace
+{
+    unsigned long const VOLUME_UP_CODE = 0xFFA857;
+    unsigned long const VOLUME_DOWN_CODE = 0xFFE01F;
+    unsigned long const OTHER_CODE = 0xFF629D;
+    unsigned long const SCENARIO_MICROS = 1500UL * 1000UL;
+    int const STATE_COUNT = MANUAL_OVERRIDE + 1;
+
+    struct Transition
+    {
+        MotorStateId From;
+        MotorStateId To;
+    };
+
+    // Taken by the default scenario counts. Reversals abandoned part way
+    // through (by a change of mind, or by manual override) are too rare to rely on
+    Transition const EXPECTED_TRANSITIONS[] =
+    {
+        { IDLE, VOLUME_INCREASING },
+        { IDLE, VOLUME_DECREASING },
+        { VOLUME_INCREASING, BRAKING },
+        { VOLUME_INCREASING, REVERSING_TO_DECREASING },
+        { VOLUME_INCREASING, MANUAL_OVERRIDE },
+        { VOLUME_DECREASING, BRAKING },
+        { VOLUME_DECREASING, REVERSING_TO_INCREASING },
+        { VOLUME_DECREASING, MANUAL_OVERRIDE },
+        { BRAKING, IDLE },
+        { BRAKING, VOLUME_INCREASING },
+        { BRAKING, VOLUME_DECREASING },
+        { BRAKING, MANUAL_OVERRIDE },
+        { REVERSING_TO_INCREASING, VOLUME_INCREASING },
+        { REVERSING_TO_DECREASING, VOLUME_DECREASING },
+        { MANUAL_OVERRIDE, IDLE }
+    };
+
+    char const * const STATE_NAMES[STATE_COUNT] =
+    {
+        "IDLE",
+        "VOLUME_INCREASING",
+        "VOLUME_DECREASING",
+        "BRAKING",
+        "REVERSING_TO_INCREASING",
+        "REVERSING_TO_DECREASING",
+        "MANUAL_OVERRIDE"
+    };
+
+    /**
+     * Reports manual movement at scheduled times
+     */
+    class ScriptedManualInput : public ManualInput
+    {
+        private:
+            unsigned long movementMicros[2] = { };
+            byte next = 0;
+
+        public:
+            void Schedule(unsigned long const first, unsigned long const second)
+            {
+                movementMicros[0] = first;
+                movementMicros[1] = second;
+                next = 0;
+            }
+
+            bool TakeManualMovement(MotorOutput const)
+            {
+                if (next == 2 || Hal::Micros() < movementMicros[next]) return false;
+                next++;
+                return true;
+            }
+
+            /**
+             * @returns The time of the next movement not yet taken, or ULONG_MAX if there are none
+             */
+            unsigned long GetNextMovementMicros() const
+            {
+                return next == 2 ? ULONG_MAX : movementMicros[next];
+            }
+    };
+
+    uint32_t randomSeed = 1;
+
+    unsigned long random(unsigned long const limit)
+    {
+        randomSeed = randomSeed * 1103515245 + 12345;
+        return (randomSeed >> 8) % limit;
+    }
+
+    /**
+     * Presses of random buttons, with repeats that are sometimes dropped or
+     * garbled, and arrive with some jitter
+     */
+    void scheduleScenario(ScriptedIrReceiver & receiver, ScriptedManualInput & manualInput)
+    {
+        unsigned long const codes[] = { VOLUME_UP_CODE, VOLUME_DOWN_CODE, OTHER_CODE };
+        unsigned long micros = random(50UL * 1000UL);
+        while (micros < SCENARIO_MICROS)
+        {
+            receiver.ScheduleCode(micros, codes[random(3)]);
+            unsigned long const repeats = random(8);
+            for (unsigned long i = 1; i <= repeats; i++)
+            {
+                unsigned long const repeatMicros = micros + i * REPEAT_PERIOD_MICROS + random(2000);
+                switch (random(8))
+                {
+                    case 0: break;
+                    case 1: receiver.ScheduleGarbledFrame(repeatMicros); break;
+                    default: receiver.ScheduleRepeat(repeatMicros); break;
+                }
+            }
+            micros += repeats * REPEAT_PERIOD_MICROS + 20UL * 1000UL + random(300UL * 1000UL);
+        }
+        if (random(4) == 0) manualInput.Schedule(random(SCENARIO_MICROS), random(SCENARIO_MICROS));
+        else manualInput.Schedule(ULONG_MAX, ULONG_MAX);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    unsigned long const scenarios = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10000;
+    unsigned long transitions[STATE_COUNT][STATE_COUNT] = { };
+    unsigned long long ticks = 0;
+    unsigned long long simulatedMicros = 0;
+
+    auto const start = std::chrono::steady_clock::now();
+    for (unsigned long scenario = 0; scenario < scenarios; scenario++)
+    {
+        Hal::Host::Reset();
+        ScriptedIrReceiver receiver;
+        ScriptedManualInput manualInput;
+        scheduleScenario(receiver, manualInput);
+        VolumeMotorStateMachine motorStateMachine(
+            receiver,
+            VolumeMotorConfig
+            {
+                .VolumeUpCode = VOLUME_UP_CODE,
+                .VolumeDownCode = VOLUME_DOWN_CODE,
+                .VolumeUpPin = 4,
+                .VolumeDownPin = 3,
+                .BrakeDurationMicros = 100UL * 1000UL,
+                .MovementTimeoutMicros = 120UL * 1000UL,
+                .SoftStartMicros = 20UL * 1000UL,
+                .SupplySagMillivolts = 0,
+                .IdlePowerDownMicros = 500UL * 1000UL,
+                .StatusLedPin = Hal::NO_PIN,
+                .MaxMissedRepeats = 1,
+                .ReversalBrakeMicros = 50UL * 1000UL,
+                .ReversalDeadTimeMicros = 1000UL,
+                .MotorDeadTimeMicros = 0,
+                .MotorEnablePin = Hal::NO_PIN,
+                .ManualHoldOffMicros = 200UL * 1000UL
+            });
+        motorStateMachine.EnableManualOverride(manualInput);
+        VirtualTimeDriver<VolumeMotorStateMachine> driver(motorStateMachine);
+
+        unsigned long const endMicros = SCENARIO_MICROS + 500UL * 1000UL;
+        MotorStateId previous = motorStateMachine.GetStateId();
+        while (Hal::Micros() < endMicros)
+        {
+            // Idle ticks do nothing until the next packet or manual movement (the
+            // status LED is not connected), so they are skipped
+            if (previous == IDLE)
+            {
+                driver.SkipTo(std::min({ receiver.GetNextPacketMicros(), manualInput.GetNextMovementMicros(), endMicros }));
+            }
+            else driver.Step();
+            auto const current = motorStateMachine.GetStateId();
+            if (current != previous) transitions[previous][current]++;
+            previous = current;
+            ticks++;
+        }
+        simulatedMicros += Hal::Micros();
+    }
+    std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+
+    printf("Scenarios: %lu in %.2fs (%.0f scenarios/s)\n", scenarios, elapsed.count(), scenarios / elapsed.count());
+    // Each skipped idle stretch is one tick run, but many periods simulated
+    printf("Ticks: %.1f M run (%.1f M/s), %.1f M periods simulated (%.0fx real time)\n\n",
+        ticks / 1e6, ticks / elapsed.count() / 1e6,
+        simulatedMicros / DEFAULT_TICK_MICROS / 1e6, simulatedMicros / 1e6 / elapsed.count());
+    int covered = 0;
+    for (int from = 0; from < STATE_COUNT; from++)
+    {
+        for (int to = 0; to < STATE_COUNT; to++)
+        {
+            if (!transitions[from][to]) continue;
+            covered++;
+            printf("%-24s -> %-24s %lu\n", STATE_NAMES[from], STATE_NAMES[to], transitions[from][to]);
+        }
+    }
+    printf("\nTransitions covered: %d\n", covered);
+
+    bool missing = false;
+    for (auto const transition : EXPECTED_TRANSITIONS)
+    {
+        if (transitions[transition.From][transition.To]) continue;
+        printf("Never taken: %s -> %s\n", STATE_NAMES[transition.From], STATE_NAMES[transition.To]);
+        missing = true;
+    }
+    return missing ? 1 : 0;
+}
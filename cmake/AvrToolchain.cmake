@@ -0,0 +1,17 @@
+# Cross compiles with the avr-gcc toolchain (e.g. the one installed with the
+# Arduino IDE, or the gcc-avr and avr-libc packages)
+
+set(CMAKE_SYSTEM_NAME Generic)
+set(CMAKE_SYSTEM_PROCESSOR avr)
+
+find_program(CMAKE_C_COMPILER avr-gcc REQUIRED)
+find_program(CMAKE_CXX_COMPILER avr-g++ REQUIRED)
+set(CMAKE_ASM_COMPILER ${CMAKE_C_COMPILER})
+find_program(AVR_OBJCOPY avr-objcopy REQUIRED)
+
+# There is no C runtime to link test programs against before -mmcu is known
+set(CMAKE_TRY_COMPILE_TARGET_TYPE STATIC_LIBRARY)
+
+set(CMAKE_FIND_ROOT_PATH_MODE_PROGRAM NEVER)
+set(CMAKE_FIND_ROOT_PATH_MODE_LIBRARY ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_INCLUDE ONLY)
\ No newline at end of file
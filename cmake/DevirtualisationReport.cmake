@@ -0,0 +1,76 @@
+# Summarises the devirtualised calls in GCC's optimisation notes, and the code
+# size (and optionally the run output) of a baseline and a size profile build
+# Run by the targets from add_devirtualisation_report (see SizeProfile.cmake)
+
+# Virtual methods of the interfaces, and the header each is declared in (header|method)
+set(VIRTUAL_METHODS
+    "StateMachine.h|State::Tick"
+    "StateMachine.h|State::OnEnterState"
+    "StateMachine.h|StateMachine::GetStateInstance"
+    "IrReceiver.h|IrReceiver::TryGetPacket"
+    "IrReceiver.h|IrReceiver::GetLastCode"
+    "IrReceiver.h|IrReceiver::PowerDownUntilSignal"
+    "IrReceiver.h|IrReceiver::SetMotorActive"
+    "IrReceiver.h|IrReceiver::GetSignalQuality"
+    "IrReceiver.h|IrReceiver::GetLastSignalMicros"
+    "ManualInput.h|ManualInput::TakeManualMovement")
+
+set(report "")
+macro(line text)
+    string(APPEND report "${text}\n")
+endmacro()
+
+file(STRINGS ${OPT_INFO} notes REGEX "devirtualizing call|to direct call")
+line("Devirtualised calls (from ${OPT_INFO})")
+line("")
+foreach(entry IN LISTS VIRTUAL_METHODS)
+    string(REPLACE "|" ";" parts ${entry})
+    list(GET parts 0 header)
+    list(GET parts 1 method)
+    string(REGEX REPLACE ".*::" "" methodName ${method})
+
+    set(direct 0)
+    set(speculative 0)
+    set(callers "")
+    foreach(note IN LISTS notes)
+        # e.g. "speculatively devirtualizing call in Tick/1595 to TryGetPacket/1040"
+        # or "converting indirect call in Tick/12 to direct call to TryGetPacket/34"
+        if(note MATCHES "call in ([^/ ]+)/[0-9]+ to (direct call to )?${methodName}/")
+            list(APPEND callers ${CMAKE_MATCH_1})
+            if(note MATCHES "speculatively")
+                math(EXPR speculative "${speculative} + 1")
+            else()
+                math(EXPR direct "${direct} + 1")
+            endif()
+        endif()
+    endforeach()
+    list(REMOVE_DUPLICATES callers)
+    list(JOIN callers ", " callers)
+    if(direct EQUAL 0 AND speculative EQUAL 0)
+        line("  ${header} ${method}: not devirtualised")
+    else()
+        line("  ${header} ${method}: ${direct} direct, ${speculative} speculative (in ${callers})")
+    endif()
+endforeach()
+line("")
+line("Speculative calls are guarded by a check of the object's type, with the")
+line("indirect call kept as a fallback, so they save time but not space")
+line("")
+
+foreach(build BASELINE PROFILE)
+    get_filename_component(name ${${build}} NAME)
+    if(SIZE_TOOL)
+        execute_process(COMMAND ${SIZE_TOOL} ${${build}} OUTPUT_VARIABLE sizes)
+        string(REGEX MATCH "\n *([0-9]+)" text "${sizes}")
+        line("${name}: ${CMAKE_MATCH_1} bytes of code (text)")
+    endif()
+    if(RUN)
+        separate_arguments(args UNIX_COMMAND "${RUN_ARGS}")
+        execute_process(COMMAND ${${build}} ${args} OUTPUT_VARIABLE output)
+        string(REGEX MATCH "[^\n]+" firstLine "${output}")
+        line("${name}: ${firstLine}")
+    endif()
+endforeach()
+
+message("${report}")
+file(WRITE ${REPORT} "${report}")
\ No newline at end of file
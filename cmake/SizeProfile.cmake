@@ -0,0 +1,55 @@
+# Build profiles for comparing code size and devirtualisation
+#
+# The Arduino profile matches the flags that the Arduino IDE builds sketches with.
+# The size profile adds whole-program optimisation, so that at link time GCC can
+# see every implementation of the State, IrReceiver and ManualInput interfaces.
+# Together with the final classes, that lets it devirtualise (and then inline)
+# calls through them where it can prove the object's type. GCC 12 does not
+# devirtualise speculatively at -Os, even when asked to, since the guard adds
+# code; building with -O2 shows the calls it would speculate on
+
+set(ARDUINO_PROFILE_FLAGS -Os -flto -fuse-linker-plugin)
+set(SIZE_PROFILE_FLAGS
+    ${ARDUINO_PROFILE_FLAGS}
+    -fwhole-program
+    -fdevirtualize-at-ltrans)
+
+function(add_arduino_profile target)
+    target_compile_options(${target} PRIVATE ${ARDUINO_PROFILE_FLAGS})
+    target_link_options(${target} PRIVATE ${ARDUINO_PROFILE_FLAGS})
+endfunction()
+
+# Also records GCC's interprocedural optimisation notes (including each
+# devirtualised call) to <target>.opt-info.txt in the build directory
+function(add_size_profile target)
+    set(optInfo ${CMAKE_CURRENT_BINARY_DIR}/${target}.opt-info.txt)
+    target_compile_options(${target} PRIVATE ${SIZE_PROFILE_FLAGS})
+    target_link_options(${target} PRIVATE ${SIZE_PROFILE_FLAGS} -fopt-info-ipa-optimized=${optInfo})
+    # GCC appends to the notes file, so start afresh on each link
+    add_custom_command(TARGET ${target} PRE_LINK COMMAND ${CMAKE_COMMAND} -E rm -f ${optInfo})
+    set_property(TARGET ${target} PROPERTY OPT_INFO_FILE ${optInfo})
+endfunction()
+
+find_program(SIZE_TOOL NAMES ${CMAKE_CXX_COMPILER_TARGET}-size avr-size size)
+
+# Adds a target that builds both profiles of a program, and reports which virtual
+# calls were devirtualised, and the code size of each. If RUN is given, both are
+# also run with RUN_ARGS, and the first line of their output (e.g. a benchmark's
+# rate) is included
+#
+# add_devirtualisation_report(<name> BASELINE <target> PROFILE <target> [RUN] [RUN_ARGS <args>...])
+function(add_devirtualisation_report name)
+    cmake_parse_arguments(REPORT "RUN" "BASELINE;PROFILE" "RUN_ARGS" ${ARGN})
+    add_custom_target(${name}
+        COMMAND ${CMAKE_COMMAND}
+            -DOPT_INFO=$<TARGET_PROPERTY:${REPORT_PROFILE},OPT_INFO_FILE>
+            -DBASELINE=$<TARGET_FILE:${REPORT_BASELINE}>
+            -DPROFILE=$<TARGET_FILE:${REPORT_PROFILE}>
+            -DSIZE_TOOL=${SIZE_TOOL}
+            -DRUN=${REPORT_RUN}
+            "-DRUN_ARGS=${REPORT_RUN_ARGS}"
+            -DREPORT=${CMAKE_CURRENT_BINARY_DIR}/${name}.txt
+            -P ${CMAKE_CURRENT_FUNCTION_LIST_DIR}/DevirtualisationReport.cmake
+        DEPENDS ${REPORT_BASELINE} ${REPORT_PROFILE}
+        VERBATIM)
+endfunction()
\ No newline at end of file
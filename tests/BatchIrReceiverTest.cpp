@@ -0,0 +1,124 @@
+/**
+ * Round-trips codes and repeats through EncodeNecCode/EncodeNecRepeat and
+ * BatchIrReceiver, as a capture peripheral would deliver them, checking the
+ * packets, the last code, the frame start times and the glitch filter
+ */
+#include <vector>
+#include "BatchIrReceiver.h"
+#include "TestUtils.h"
+
+using namespace IrReceiverUtils;
+using namespace TestUtils;
+
+namespace
+{
+    unsigned long const CODES[] = { 0x00000000UL, 0xFFFFFFFFUL, 0xFFA857UL, 0xFFE01FUL, 0x20DF10EFUL };
+    unsigned long const REPEAT_PERIOD_MICROS = 108000UL;
+    // Glitches from motor noise, shorter than the glitch filter
+    unsigned int const GLITCH_MARK_MICROS = 20;
+    unsigned int const GLITCH_OFFSET_MICROS = 300;
+
+    std::vector<IrSymbol> encodeCode(unsigned long const code)
+    {
+        std::vector<IrSymbol> symbols(SYMBOLS_PER_CODE);
+        symbols.resize(EncodeNecCode(code, symbols.data()));
+        return symbols;
+    }
+
+    std::vector<IrSymbol> encodeRepeat()
+    {
+        std::vector<IrSymbol> symbols(SYMBOLS_PER_REPEAT);
+        symbols.resize(EncodeNecRepeat(symbols.data()));
+        return symbols;
+    }
+
+    /**
+     * Splits the space after each bit's burst with a glitch, leaving every other signal fall where it was
+     */
+    std::vector<IrSymbol> addGlitches(std::vector<IrSymbol> const & symbols)
+    {
+        std::vector<IrSymbol> glitched;
+        for (size_t i = 0; i < symbols.size(); i++)
+        {
+            auto const symbol = symbols[i];
+            bool const isBit = i > 0 && i + 1 < symbols.size();
+            if (!isBit)
+            {
+                glitched.push_back(symbol);
+                continue;
+            }
+            glitched.push_back(IrSymbol { symbol.MarkMicros, GLITCH_OFFSET_MICROS });
+            glitched.push_back(IrSymbol { GLITCH_MARK_MICROS, symbol.SpaceMicros - GLITCH_OFFSET_MICROS - GLITCH_MARK_MICROS });
+        }
+        return glitched;
+    }
+
+    /**
+     * Time from the signal fall at the end of the AGC burst to the last signal fall
+     */
+    unsigned long frameMicrosAfterAgc(std::vector<IrSymbol> const & symbols)
+    {
+        unsigned long micros = 0;
+        for (size_t i = 1; i < symbols.size(); i++) micros += symbols[i - 1].SpaceMicros + symbols[i].MarkMicros;
+        return micros;
+    }
+
+    /**
+     * Delivers a frame as the peripheral would, once its last burst has ended
+     */
+    void capture(BatchIrReceiver & receiver, std::vector<IrSymbol> const & symbols)
+    {
+        Hal::Host::AdvanceMicros(REPEAT_PERIOD_MICROS);
+        receiver.OnCapture(symbols.data(), symbols.size());
+    }
+
+    void checkFrameStart(BatchIrReceiver const & receiver, std::vector<IrSymbol> const & symbols, char const * const name)
+    {
+        auto const expectedMicros = Hal::Micros() - frameMicrosAfterAgc(symbols);
+        Check(receiver.GetLastFrameStartMicros() == expectedMicros, "%s: frame started at %lu, expected %lu",
+            name, receiver.GetLastFrameStartMicros(), expectedMicros);
+    }
+}
+
+int main()
+{
+    Hal::Host::Reset();
+    BatchIrReceiver receiver;
+    IrPacket packet;
+
+    // Each code, then a couple of repeats
+    for (auto const code : CODES)
+    {
+        auto const codeSymbols = encodeCode(code);
+        capture(receiver, codeSymbols);
+        bool const received = receiver.TryGetPacket(packet);
+        Check(received && !packet.IsRepeat && packet.Code == code,
+            "Code 0x%08lX: received %d, repeat %d, code 0x%08lX", code, received, packet.IsRepeat, packet.Code);
+        Check(receiver.GetLastCode() == code, "Code 0x%08lX: last code 0x%08lX", code, receiver.GetLastCode());
+        checkFrameStart(receiver, codeSymbols, "Code");
+        Check(!receiver.TryGetPacket(packet), "Code 0x%08lX: packet read twice", code);
+
+        auto const repeatSymbols = encodeRepeat();
+        for (int repeat = 0; repeat < 2; repeat++)
+        {
+            capture(receiver, repeatSymbols);
+            Check(receiver.TryGetPacket(packet) && packet.IsRepeat, "Code 0x%08lX: repeat %d not received", code, repeat);
+            Check(receiver.GetLastCode() == code, "Code 0x%08lX: last code 0x%08lX after a repeat", code, receiver.GetLastCode());
+            checkFrameStart(receiver, repeatSymbols, "Repeat");
+        }
+    }
+
+    // Glitches within a code are filtered while the motor is active, but corrupt it otherwise
+    unsigned long const glitchedCode = 0xFFA857UL;
+    auto const glitchedSymbols = addGlitches(encodeCode(glitchedCode));
+    receiver.SetMotorActive(true);
+    capture(receiver, glitchedSymbols);
+    Check(receiver.TryGetPacket(packet) && !packet.IsRepeat && packet.Code == glitchedCode,
+        "Glitched code, motor active: not received");
+    checkFrameStart(receiver, glitchedSymbols, "Glitched code");
+
+    receiver.SetMotorActive(false);
+    capture(receiver, glitchedSymbols);
+    Check(!receiver.TryGetPacket(packet), "Glitched code, motor idle: received 0x%08lX", packet.Code);
+    return ExitCode();
+}
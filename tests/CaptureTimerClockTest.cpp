@@ -0,0 +1,106 @@
+/**
+ * Checks CaptureTimerClock's intervals: rounded to the nearest microsecond,
+ * correct across a wrap of the capture timer, and not aliased when longer
+ * than the timer's period. Then decodes with an InputPinIrReceiver timed by it,
+ * and checks that it cannot detach a receiver with another clock that replaced it
+ */
+#include "IrReceiver.h"
+#include "TestUtils.h"
+
+using namespace IrReceiverUtils;
+using namespace TestUtils;
+
+namespace
+{
+    int const IR_RECV_PIN = 2;
+    unsigned long const CODE = 0xFFA857UL;
+    int const REPEATS = 10;
+    // The capture timer's period, in microseconds
+    unsigned long const TIMER_PERIOD_MICROS = 0x10000UL / Hal::CAPTURE_TIMER_TICKS_PER_MICRO;
+
+    void checkElapsed(
+        char const * const name,
+        CaptureTimerClock::Time const start,
+        CaptureTimerClock::Time const end,
+        unsigned long const expectedMicros)
+    {
+        auto const elapsedMicros = CaptureTimerClock::ElapsedMicros(start, end);
+        Check(elapsedMicros == expectedMicros, "%s: %luus, expected %luus", name, elapsedMicros, expectedMicros);
+    }
+
+    /**
+     * Advances the clock to the given time, and pulls the receiver's pin LOW and back HIGH
+     */
+    void signalFall(unsigned long const micros)
+    {
+        Hal::Host::AdvanceMicros(micros - Hal::Micros());
+        Hal::Host::SetInputLevel(IR_RECV_PIN, Hal::PIN_LOW);
+        Hal::Host::SetInputLevel(IR_RECV_PIN, Hal::PIN_HIGH);
+    }
+
+    /**
+     * Sends CODE, starting at the given time
+     *
+     * @returns The time of the last signal fall
+     */
+    unsigned long sendCode(unsigned long micros)
+    {
+        signalFall(micros);
+        micros += AGC_DURATION;
+        signalFall(micros);
+        for (byte bitIndex = BITS_PER_CODE; bitIndex > 0; bitIndex--)
+        {
+            micros += (CODE >> (bitIndex - 1)) & 1UL ? ONE_DURATION : ZERO_DURATION;
+            signalFall(micros);
+        }
+        return micros;
+    }
+}
+
+int main()
+{
+    // Hal::Micros only counts in steps of 4us on AVR, so its readings may differ
+    // from the timer's by a few microseconds
+    checkElapsed("3.5us, rounded up", { 1000, 100 }, { 1000, 107 }, 4);
+    checkElapsed("2.5us, rounded up", { 1000, 100 }, { 1004, 105 }, 3);
+    checkElapsed("Timer wrap", { 1000, 0xFFF0 }, { 1016, 0x0010 }, 16);
+    checkElapsed("Longer than the timer's period", { 1000, 0 }, { 1000 + TIMER_PERIOD_MICROS + REPEAT_DURATION, 2 * REPEAT_DURATION },
+        TIMER_PERIOD_MICROS + REPEAT_DURATION);
+
+    Hal::Host::Reset();
+    Hal::Host::SetInputLevel(IR_RECV_PIN, Hal::PIN_HIGH);
+    InputPinIrReceiver<IR_RECV_PIN, CaptureTimerClock> receiver(false);
+    receiver.Attach();
+
+    // A code and its repeats, over which the timer wraps several times
+    unsigned long micros = sendCode(40000UL);
+    IrPacket packet;
+    Check(receiver.TryGetPacket(packet) && !packet.IsRepeat && packet.Code == CODE, "Code: not received");
+    int repeats = 0;
+    for (int repeat = 0; repeat < REPEATS; repeat++)
+    {
+        micros += 96000UL;
+        signalFall(micros);
+        micros += REPEAT_DURATION;
+        signalFall(micros);
+        repeats += receiver.TryGetPacket(packet) && packet.IsRepeat;
+    }
+    Check(repeats == REPEATS, "Repeats: %d received, expected %d", repeats, REPEATS);
+
+    // An idle gap that the timer alone would see as a repeat
+    micros += 96000UL;
+    signalFall(micros);
+    micros += TIMER_PERIOD_MICROS + REPEAT_DURATION;
+    signalFall(micros);
+    Check(!receiver.TryGetPacket(packet), "Idle gap of the timer's period plus a repeat: decoded as a packet");
+
+    // A receiver with the default clock takes over the pin, and the first cannot detach it
+    InputPinIrReceiver<IR_RECV_PIN> replacement(false);
+    replacement.Attach();
+    receiver.Detach();
+    sendCode(micros + 96000UL);
+    Check(replacement.TryGetPacket(packet) && !packet.IsRepeat && packet.Code == CODE,
+        "Replaced receiver detached its replacement");
+    Check(!receiver.TryGetPacket(packet), "Replaced receiver still decoding");
+    return ExitCode();
+}
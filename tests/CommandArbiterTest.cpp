@@ -0,0 +1,137 @@
+/**
+ * Checks that CommandArbiter gives control to the higher priority of the IR
+ * receiver and a pair of buttons, drops the other source's commands until
+ * the one in control times out, then lets it take over with its last code
+ */
+#include <vector>
+#include "CommandArbiter.h"
+#include "Simulation.h"
+#include "TestUtils.h"
+
+using namespace CommandArbiterUtils;
+using namespace SimulationUtils;
+using namespace TestUtils;
+
+namespace
+{
+    int const VOLUME_UP_BUTTON_PIN = 5;
+    int const VOLUME_DOWN_BUTTON_PIN = 6;
+    unsigned long const VOLUME_UP_CODE = 0xFFA857;
+    unsigned long const VOLUME_DOWN_CODE = 0xFFE01F;
+    unsigned long const TIMEOUT_MICROS = 150UL * 1000UL;
+    unsigned long const POLL_PERIOD_MICROS = 1000UL;
+
+    // The up button is pressed 50ms in, and the remote's down button held from 100ms
+    unsigned long const BUTTON_PRESS_MICROS = 50UL * 1000UL;
+    unsigned long const IR_HOLD_MICROS = 100UL * 1000UL;
+
+    struct Command
+    {
+        IrPacket Packet;
+        unsigned long LastCode; // CommandArbiter::GetLastCode after reading the packet
+    };
+
+    IrPacket const BUTTON_CODE { false, VOLUME_UP_CODE };
+    IrPacket const IR_CODE { false, VOLUME_DOWN_CODE };
+    IrPacket const REPEAT { true, 0 };
+
+    /**
+     * Polls the arbiter until the given time, pressing the up button between the given times
+     */
+    std::vector<Command> run(
+        CommandArbiter & arbiter,
+        unsigned long const releaseMicros,
+        unsigned long const endMicros)
+    {
+        std::vector<Command> commands;
+        for (; Hal::Micros() < endMicros; Hal::Host::AdvanceMicros(POLL_PERIOD_MICROS))
+        {
+            bool const pressed = Hal::Micros() >= BUTTON_PRESS_MICROS && Hal::Micros() < releaseMicros;
+            // Active low
+            Hal::Host::SetInputLevel(VOLUME_UP_BUTTON_PIN, !pressed);
+            IrPacket packet;
+            while (arbiter.TryGetPacket(packet)) commands.push_back(Command { packet, arbiter.GetLastCode() });
+        }
+        return commands;
+    }
+
+    void checkCommands(char const * const name, std::vector<Command> const & actual, std::vector<Command> const & expected)
+    {
+        Check(actual.size() == expected.size(), "%s: %zu commands, expected %zu", name, actual.size(), expected.size());
+        for (size_t i = 0; i < actual.size() && i < expected.size(); i++)
+        {
+            auto const & a = actual[i];
+            auto const & e = expected[i];
+            Check(a.Packet.IsRepeat == e.Packet.IsRepeat && a.Packet.Code == e.Packet.Code && a.LastCode == e.LastCode,
+                "%s, command %zu: %s %lX (last code %lX), expected %s %lX (last code %lX)", name, i,
+                a.Packet.IsRepeat ? "repeat" : "code", a.Packet.Code, a.LastCode,
+                e.Packet.IsRepeat ? "repeat" : "code", e.Packet.Code, e.LastCode);
+        }
+    }
+
+    /**
+     * Runs a scenario with the given priorities. The remote holds its button
+     * for a code and the given number of repeats
+     */
+    std::vector<Command> runScenario(
+        byte const irPriority,
+        byte const buttonPriority,
+        unsigned int const irRepeats,
+        unsigned long const releaseMicros,
+        unsigned long const endMicros)
+    {
+        Hal::Host::Reset();
+        Hal::Host::SetInputLevel(VOLUME_UP_BUTTON_PIN, true);
+        Hal::Host::SetInputLevel(VOLUME_DOWN_BUTTON_PIN, true);
+        ScriptedIrReceiver receiver;
+        receiver.ScheduleHold(IR_HOLD_MICROS, VOLUME_DOWN_CODE, irRepeats);
+        ButtonCommandSource<VOLUME_UP_BUTTON_PIN, VOLUME_DOWN_BUTTON_PIN> buttons(VOLUME_UP_CODE, VOLUME_DOWN_CODE, true);
+        CommandArbiter arbiter(receiver, irPriority, TIMEOUT_MICROS);
+        arbiter.AddSource(buttons, buttonPriority, TIMEOUT_MICROS);
+        return run(arbiter, releaseMicros, endMicros);
+    }
+}
+
+int main()
+{
+    // The remote outranks the buttons. It takes over from the held button straight
+    // away, and the button's repeats are dropped until the remote has been quiet
+    // for its timeout (574ms), when the button takes back over with its code
+    // (on its repeat at 590ms)
+    checkCommands("IR priority",
+        runScenario(2, 1, 3, 1000UL * 1000UL, 750UL * 1000UL),
+        {
+            { BUTTON_CODE, VOLUME_UP_CODE }, // 50ms
+            { IR_CODE, VOLUME_DOWN_CODE }, // 100ms
+            { REPEAT, VOLUME_DOWN_CODE }, // 208ms
+            { REPEAT, VOLUME_DOWN_CODE }, // 316ms
+            { REPEAT, VOLUME_DOWN_CODE }, // 424ms
+            { BUTTON_CODE, VOLUME_UP_CODE }, // 590ms
+            { REPEAT, VOLUME_UP_CODE } // 698ms
+        });
+
+    // The buttons outrank the remote. The remote's packets are dropped while the
+    // button is held, and until its timeout after the button's last repeat (416ms),
+    // when the remote takes over with the code it sent while dropped (on its
+    // repeat at 424ms)
+    checkCommands("Button priority",
+        runScenario(2, 3, 5, 300UL * 1000UL, 600UL * 1000UL),
+        {
+            { BUTTON_CODE, VOLUME_UP_CODE }, // 50ms
+            { REPEAT, VOLUME_UP_CODE }, // 158ms
+            { REPEAT, VOLUME_UP_CODE }, // 266ms
+            { IR_CODE, VOLUME_DOWN_CODE }, // 424ms
+            { REPEAT, VOLUME_DOWN_CODE } // 532ms
+        });
+
+    // Equal priorities: whichever sent last takes over straight away
+    checkCommands("Equal priority",
+        runScenario(2, 2, 1, 180UL * 1000UL, 300UL * 1000UL),
+        {
+            { BUTTON_CODE, VOLUME_UP_CODE }, // 50ms
+            { IR_CODE, VOLUME_DOWN_CODE }, // 100ms
+            { BUTTON_CODE, VOLUME_UP_CODE }, // 158ms
+            { IR_CODE, VOLUME_DOWN_CODE } // 208ms
+        });
+    return ExitCode();
+}
@@ -0,0 +1,191 @@
+/**
+ * Checks that QuadratureManualInput decodes encoder steps, only reports
+ * movement of at least its threshold, and ignores steps in the driven
+ * direction, and that SlipManualInput reports each slip. Then checks that
+ * turning the knob stops the motor for ManualHoldOffMicros, that turning it
+ * again extends the hold-off, and that turns made while idle are not acted on
+ */
+#include "Simulation.h"
+#include "ManualInput.h"
+#include "VolumeMotorStateMachine.h"
+#include "TestUtils.h"
+
+using namespace ManualInputUtils;
+using namespace SimulationUtils;
+using namespace VolumeMotorUtils;
+using namespace TestUtils;
+
+namespace
+{
+    int const VOLUME_UP_PIN = 4;
+    int const VOLUME_DOWN_PIN = 3;
+    int const ENCODER_PIN_A = 8;
+    int const ENCODER_PIN_B = 9;
+    int const SLIP_SENSOR_PIN = 10;
+    unsigned long const VOLUME_UP_CODE = 0xFFA857;
+    unsigned long const VOLUME_DOWN_CODE = 0xFFE01F;
+    unsigned long const HOLD_OFF_MICROS = 1000UL * 1000UL;
+    unsigned long const SETTLE_MICROS = 1000UL;
+
+    typedef QuadratureManualInput<ENCODER_PIN_A, ENCODER_PIN_B> Encoder;
+
+    // Levels of (A, B) through one cycle in the volume up direction
+    bool const VOLUME_UP_CYCLE[4][2] = { { false, false }, { true, false }, { true, true }, { false, true } };
+    int encoderPhase = 0;
+
+    /**
+     * Turns the encoder by the given number of steps, positive towards volume up
+     */
+    void turn(int const steps)
+    {
+        for (int i = 0; i < (steps < 0 ? -steps : steps); i++)
+        {
+            encoderPhase = (encoderPhase + (steps < 0 ? 3 : 1)) % 4;
+            Hal::Host::SetInputLevel(ENCODER_PIN_A, VOLUME_UP_CYCLE[encoderPhase][0]);
+            Hal::Host::SetInputLevel(ENCODER_PIN_B, VOLUME_UP_CYCLE[encoderPhase][1]);
+        }
+    }
+
+    void resetEncoder()
+    {
+        Hal::Host::Reset();
+        encoderPhase = 0;
+        Hal::Host::SetInputLevel(ENCODER_PIN_A, false);
+        Hal::Host::SetInputLevel(ENCODER_PIN_B, false);
+    }
+
+    void checkQuadrature()
+    {
+        resetEncoder();
+        Encoder encoder;
+        encoder.Attach();
+
+        turn(1);
+        Check(!encoder.TakeManualMovement(MOTOR_COAST), "One step: counted as movement");
+        turn(1);
+        Check(encoder.TakeManualMovement(MOTOR_COAST), "Two steps up: not counted as movement");
+        Check(!encoder.TakeManualMovement(MOTOR_COAST), "Movement counted twice");
+        turn(-2);
+        Check(encoder.TakeManualMovement(MOTOR_COAST), "Two steps down: not counted as movement");
+
+        // A full cycle is four steps, in either direction
+        turn(4);
+        Check(encoder.TakeManualMovement(MOTOR_VOLUME_DOWN), "Full cycle up, driven down: not counted as movement");
+        turn(-4);
+        Check(encoder.TakeManualMovement(MOTOR_VOLUME_UP), "Full cycle down, driven up: not counted as movement");
+
+        turn(3);
+        Check(!encoder.TakeManualMovement(MOTOR_VOLUME_UP), "Steps in the driven direction: counted as movement");
+        turn(-3);
+        Check(!encoder.TakeManualMovement(MOTOR_VOLUME_DOWN), "Steps in the driven direction: counted as movement");
+
+        // Steps in the driven direction clear any opposing steps pending
+        turn(-1);
+        Check(!encoder.TakeManualMovement(MOTOR_VOLUME_UP), "One opposing step: counted as movement");
+        turn(2);
+        Check(!encoder.TakeManualMovement(MOTOR_VOLUME_UP), "Steps in the driven direction: counted as movement");
+        turn(-1);
+        Check(!encoder.TakeManualMovement(MOTOR_VOLUME_UP), "Opposing steps either side of driven steps: counted as movement");
+
+        // Steps too far apart do not add up
+        turn(1);
+        Check(!encoder.TakeManualMovement(MOTOR_COAST), "One step: counted as movement");
+        Hal::Host::AdvanceMicros(QUADRATURE_STEP_WINDOW_MICROS + 1);
+        turn(1);
+        Check(!encoder.TakeManualMovement(MOTOR_COAST), "Steps outside the window: counted as movement");
+
+        encoder.Detach();
+        turn(2);
+        Check(!encoder.TakeManualMovement(MOTOR_COAST), "Detached: counted as movement");
+    }
+
+    void checkSlip()
+    {
+        Hal::Host::Reset();
+        Hal::Host::SetInputLevel(SLIP_SENSOR_PIN, false);
+        SlipManualInput<SLIP_SENSOR_PIN> sensor;
+        sensor.Attach();
+
+        Check(!sensor.TakeManualMovement(MOTOR_VOLUME_UP), "No slip: counted as movement");
+        Hal::Host::SetInputLevel(SLIP_SENSOR_PIN, true);
+        Check(sensor.TakeManualMovement(MOTOR_VOLUME_UP), "Slip, driven up: not counted as movement");
+        Check(!sensor.TakeManualMovement(MOTOR_VOLUME_UP), "Slip counted twice");
+        Hal::Host::SetInputLevel(SLIP_SENSOR_PIN, false);
+        Check(sensor.TakeManualMovement(MOTOR_VOLUME_DOWN), "Slip, driven down: not counted as movement");
+    }
+
+    void checkHoldOff()
+    {
+        resetEncoder();
+        ScriptedIrReceiver receiver;
+        // Held past the end of the first hold-off, but released before the extended one ends
+        receiver.ScheduleHold(10UL * 1000UL, VOLUME_UP_CODE, 12);
+        VolumeMotorStateMachine motorStateMachine(
+            receiver,
+            VolumeMotorConfig
+            {
+                .VolumeUpCode = VOLUME_UP_CODE,
+                .VolumeDownCode = VOLUME_DOWN_CODE,
+                .VolumeUpPin = VOLUME_UP_PIN,
+                .VolumeDownPin = VOLUME_DOWN_PIN,
+                .BrakeDurationMicros = 100UL * 1000UL,
+                .MovementTimeoutMicros = 120UL * 1000UL,
+                .SoftStartMicros = 0,
+                .SupplySagMillivolts = 0,
+                .IdlePowerDownMicros = 0,
+                .StatusLedPin = Hal::NO_PIN,
+                .MaxMissedRepeats = 0,
+                .ReversalBrakeMicros = 0,
+                .ReversalDeadTimeMicros = 0,
+                .MotorDeadTimeMicros = 0,
+                .MotorEnablePin = Hal::NO_PIN,
+                .ManualHoldOffMicros = HOLD_OFF_MICROS
+            });
+        Encoder encoder;
+        encoder.Attach();
+        motorStateMachine.EnableManualOverride(encoder);
+        VirtualTimeDriver<VolumeMotorStateMachine> driver(motorStateMachine);
+
+        driver.RunUntil(50UL * 1000UL);
+        Check(motorStateMachine.GetStateId() == VOLUME_INCREASING, "Remote held: motor not moving");
+        // The motor's own movement
+        turn(3);
+        driver.RunFor(SETTLE_MICROS);
+        Check(motorStateMachine.GetStateId() == VOLUME_INCREASING, "Turned in the driven direction: motor stopped");
+
+        turn(-2);
+        driver.RunFor(SETTLE_MICROS);
+        unsigned long const overrideMicros = Hal::Micros();
+        Check(motorStateMachine.GetStateId() == MANUAL_OVERRIDE, "Turned against the motor: no manual override");
+        Check(!Hal::Host::GetOutputLevel(VOLUME_UP_PIN) && !Hal::Host::GetOutputLevel(VOLUME_DOWN_PIN),
+            "Manual override: motor still driven");
+
+        // The remote's repeats are ignored, and turning again extends the hold-off
+        driver.RunFor(HOLD_OFF_MICROS / 2);
+        turn(-2);
+        driver.RunFor(SETTLE_MICROS);
+        unsigned long const extendedMicros = Hal::Micros();
+        driver.RunUntil(overrideMicros + HOLD_OFF_MICROS + SETTLE_MICROS);
+        Check(motorStateMachine.GetStateId() == MANUAL_OVERRIDE, "Turned again: hold-off not extended");
+        driver.RunUntil(extendedMicros + HOLD_OFF_MICROS);
+        Check(motorStateMachine.GetStateId() == IDLE, "Hold-off over: not idle");
+        driver.RunFor(200UL * 1000UL);
+        Check(motorStateMachine.GetStateId() == IDLE, "Remote released during the hold-off: motor moving");
+
+        // Turns while idle are taken, so are not acted on once the motor moves
+        turn(-2);
+        driver.RunFor(SETTLE_MICROS);
+        Check(motorStateMachine.GetStateId() == IDLE, "Turned while idle: left idle");
+        receiver.ScheduleCode(Hal::Micros() + SETTLE_MICROS, VOLUME_UP_CODE);
+        driver.RunFor(50UL * 1000UL);
+        Check(motorStateMachine.GetStateId() == VOLUME_INCREASING, "Remote pressed after an idle turn: motor not moving");
+    }
+}
+
+int main()
+{
+    checkQuadrature();
+    checkSlip();
+    checkHoldOff();
+    return ExitCode();
+}
@@ -0,0 +1,281 @@
+/**
+ * Checks that the motor rides through repeats lost to a poor demodulator
+ * (see VolumeMotorConfig::MaxMissedRepeats), but still brakes promptly
+ * when the button is released, even while motor noise reaches the receiver
+ *
+ * Drives the receiver's pin with NEC waveforms in simulated time, so the
+ * real receiver decodes them and times the frame starts
+ */
+#include <random>
+#include <vector>
+#include "IrReceiver.h"
+#include "VolumeMotorStateMachine.h"
+#include "TestUtils.h"
+
+using namespace IrReceiverUtils;
+using namespace VolumeMotorUtils;
+using namespace TestUtils;
+
+namespace
+{
+    int const IR_RECV_PIN = 2;
+    int const VOLUME_UP_PIN = 4;
+    int const VOLUME_DOWN_PIN = 3;
+    unsigned long const VOLUME_UP_CODE = 0xFFA857;
+    unsigned long const VOLUME_DOWN_CODE = 0xFFE01F;
+    unsigned long const MOVEMENT_TIMEOUT_MICROS = 120UL * 1000UL;
+    unsigned long const LOOP_PERIOD_MICROS = 50UL;
+    unsigned long const PIN_STEP_MICROS = 10UL;
+    // Braking may begin up to a loop period after the timeout expires
+    unsigned long const LATENCY_ALLOWANCE_MICROS = 2 * LOOP_PERIOD_MICROS;
+
+    // NEC burst timings, see https://www.sbprojects.net/knowledge/ir/nec.php
+    unsigned long const AGC_MARK_MICROS = 9000UL;
+    unsigned long const BIT_MARK_MICROS = 560UL;
+    unsigned long const HOLD_START_MICROS = 10UL * 1000UL;
+
+    // Noise from a brushed motor, as signal falls at random intervals while it is
+    // driven or braked. Too frequent to fake a repeat or AGC interval once the
+    // glitch filter has dropped the closest, but frequent enough that the
+    // receiver always has a recent signal fall
+    unsigned long const NOISE_MIN_INTERVAL_MICROS = 200UL;
+    unsigned long const NOISE_MAX_INTERVAL_MICROS = 1500UL;
+    // Noise at random (Poisson) times, as in CaptureRateBenchmark, whose gaps
+    // are sometimes as long as a repeat interval
+    double const POISSON_NOISE_MEAN_INTERVAL_MICROS = 1000.0;
+
+    struct Mark
+    {
+        unsigned long StartMicros;
+        unsigned long EndMicros;
+    };
+
+    /**
+     * A button held for a code and the given number of repeats, whose frames
+     * start every REPEAT_PERIOD_MICROS. Repeats listed in lostRepeats lose
+     * the burst after their AGC burst, as with a poor demodulator
+     *
+     * @returns The time of the signal fall at the end of the last repeat's AGC burst
+     */
+    unsigned long addHold(
+        std::vector<Mark> & marks,
+        unsigned long const code,
+        unsigned int const repeats,
+        std::vector<unsigned int> const & lostRepeats = { })
+    {
+        auto const addMark = [&](unsigned long const startMicros, unsigned long const durationMicros)
+        {
+            marks.push_back(Mark { startMicros, startMicros + durationMicros });
+            return startMicros + durationMicros;
+        };
+
+        unsigned long micros = addMark(HOLD_START_MICROS, AGC_MARK_MICROS);
+        micros = addMark(micros + AGC_DURATION - BIT_MARK_MICROS, BIT_MARK_MICROS);
+        for (byte bitIndex = BITS_PER_CODE; bitIndex > 0; bitIndex--)
+        {
+            unsigned long const intervalMicros = (code >> (bitIndex - 1)) & 1UL ? ONE_DURATION : ZERO_DURATION;
+            micros = addMark(micros + intervalMicros - BIT_MARK_MICROS, BIT_MARK_MICROS);
+        }
+
+        unsigned long frameStartMicros = 0;
+        for (unsigned int repeat = 1; repeat <= repeats; repeat++)
+        {
+            frameStartMicros = addMark(HOLD_START_MICROS + repeat * REPEAT_PERIOD_MICROS, AGC_MARK_MICROS);
+            bool lost = false;
+            for (auto const lostRepeat : lostRepeats) lost = lost || lostRepeat == repeat;
+            if (!lost) addMark(frameStartMicros + REPEAT_DURATION - BIT_MARK_MICROS, BIT_MARK_MICROS);
+        }
+        return frameStartMicros;
+    }
+
+    struct Result
+    {
+        unsigned long BrakeCount;
+        unsigned long LastBrakeMicros; // When braking last began
+        bool MovingAtEnd; // Whether the motor was still moving when the simulation ended
+    };
+
+    /**
+     * @param noiseSeed Seeds the motor noise. Zero for none
+     * @param noiseStartMicros Motor noise is only injected after this
+     * @param poissonNoise Whether the noise arrives at random (Poisson) times,
+     * rather than at uniformly distributed intervals
+     */
+    Result simulate(
+        std::vector<Mark> const & marks,
+        byte const maxMissedRepeats,
+        unsigned int const noiseSeed = 0,
+        unsigned long const noiseStartMicros = 0,
+        bool const poissonNoise = false)
+    {
+        Hal::Host::Reset();
+        // Inverted demodulator: the pin idles HIGH and is LOW during a mark
+        Hal::Host::SetInputLevel(IR_RECV_PIN, Hal::PIN_HIGH);
+        InputPinIrReceiver<IR_RECV_PIN> receiver(/*inverted:*/true);
+        VolumeMotorStateMachine motorStateMachine(
+            receiver.Attach(),
+            VolumeMotorConfig
+            {
+                .VolumeUpCode = VOLUME_UP_CODE,
+                .VolumeDownCode = VOLUME_DOWN_CODE,
+                .VolumeUpPin = VOLUME_UP_PIN,
+                .VolumeDownPin = VOLUME_DOWN_PIN,
+                .BrakeDurationMicros = 100UL * 1000UL,
+                .MovementTimeoutMicros = MOVEMENT_TIMEOUT_MICROS,
+                .SoftStartMicros = 0,
+                .SupplySagMillivolts = 0,
+                .IdlePowerDownMicros = 0,
+                .StatusLedPin = Hal::NO_PIN,
+                .MaxMissedRepeats = maxMissedRepeats,
+                .ReversalBrakeMicros = 0,
+                .ReversalDeadTimeMicros = 0,
+                .MotorDeadTimeMicros = 0,
+                .MotorEnablePin = Hal::NO_PIN,
+                .ManualHoldOffMicros = 0
+            });
+
+        std::mt19937 random(noiseSeed);
+        std::uniform_int_distribution<unsigned long> uniformNoiseInterval(NOISE_MIN_INTERVAL_MICROS, NOISE_MAX_INTERVAL_MICROS);
+        std::exponential_distribution<double> poissonNoiseInterval(1.0 / POISSON_NOISE_MEAN_INTERVAL_MICROS);
+        auto const noiseInterval = [&]()
+        {
+            return poissonNoise ? static_cast<unsigned long>(poissonNoiseInterval(random)) + 1 : uniformNoiseInterval(random);
+        };
+        unsigned long nextNoiseMicros = 0;
+
+        Result result { 0, 0, false };
+        bool wasBraking = false;
+        size_t nextMark = 0;
+        bool inMark = false;
+        unsigned long const endMicros = marks.back().EndMicros + 600UL * 1000UL;
+        while (Hal::Micros() < endMicros)
+        {
+            Hal::Host::AdvanceMicros(PIN_STEP_MICROS);
+            auto const currentMicros = Hal::Micros();
+            while (nextMark < marks.size() && marks[nextMark].EndMicros <= currentMicros) nextMark++;
+            bool const mark = nextMark < marks.size() && marks[nextMark].StartMicros <= currentMicros;
+            if (mark != inMark)
+            {
+                Hal::Host::SetInputLevel(IR_RECV_PIN, mark ? Hal::PIN_LOW : Hal::PIN_HIGH);
+                inMark = mark;
+            }
+
+            bool const up = Hal::Host::GetOutputLevel(VOLUME_UP_PIN);
+            bool const down = Hal::Host::GetOutputLevel(VOLUME_DOWN_PIN);
+            if (!noiseSeed || currentMicros < noiseStartMicros || !(up || down))
+            {
+                nextNoiseMicros = currentMicros + noiseInterval();
+            }
+            else if (!mark && currentMicros >= nextNoiseMicros)
+            {
+                // A glitch too short to matter other than for its signal fall
+                Hal::Host::SetInputLevel(IR_RECV_PIN, Hal::PIN_LOW);
+                Hal::Host::SetInputLevel(IR_RECV_PIN, Hal::PIN_HIGH);
+                nextNoiseMicros = currentMicros + noiseInterval();
+            }
+
+            if (currentMicros % LOOP_PERIOD_MICROS) continue;
+            motorStateMachine.Tick();
+            bool const braking = motorStateMachine.GetStateId() == BRAKING;
+            if (braking && !wasBraking)
+            {
+                result.BrakeCount++;
+                result.LastBrakeMicros = currentMicros;
+            }
+            wasBraking = braking;
+        }
+        auto const stateId = motorStateMachine.GetStateId();
+        result.MovingAtEnd = stateId == VOLUME_INCREASING || stateId == VOLUME_DECREASING;
+        return result;
+    }
+
+    /**
+     * The last repeat's packet is decoded a repeat interval after its frame starts.
+     * Negative if the motor last braked before then
+     */
+    long releaseLatencyMicros(Result const & result, unsigned long const lastFrameStartMicros)
+    {
+        return static_cast<long>(result.LastBrakeMicros - (lastFrameStartMicros + REPEAT_DURATION));
+    }
+
+    bool isPrompt(long const latencyMicros)
+    {
+        return latencyMicros >= 0 && latencyMicros <= static_cast<long>(MOVEMENT_TIMEOUT_MICROS + LATENCY_ALLOWANCE_MICROS);
+    }
+}
+
+int main()
+{
+    unsigned int const repeats = 8;
+
+    // A clean hold brakes once, a movement timeout after the last repeat
+    for (byte maxMissedRepeats = 0; maxMissedRepeats <= 2; maxMissedRepeats++)
+    {
+        std::vector<Mark> marks;
+        auto const lastFrameStartMicros = addHold(marks, VOLUME_UP_CODE, repeats);
+        auto const result = simulate(marks, maxMissedRepeats);
+        auto const latencyMicros = releaseLatencyMicros(result, lastFrameStartMicros);
+        Check(result.BrakeCount == 1, "Clean hold (%u missed repeats bridged): braked %lu times",
+            maxMissedRepeats, result.BrakeCount);
+        Check(isPrompt(latencyMicros),
+            "Clean hold (%u missed repeats bridged): braked %ldus after release",
+            maxMissedRepeats, latencyMicros);
+    }
+
+    // A repeat whose burst was lost stutters the motor, unless it is bridged
+    {
+        std::vector<Mark> marks;
+        auto const lastFrameStartMicros = addHold(marks, VOLUME_UP_CODE, repeats, { 4 });
+        auto const stuttered = simulate(marks, 0);
+        auto const bridged = simulate(marks, 1);
+        Check(stuttered.BrakeCount == 2, "Lost repeat, not bridged: braked %lu times", stuttered.BrakeCount);
+        Check(bridged.BrakeCount == 1, "Lost repeat, bridged: braked %lu times", bridged.BrakeCount);
+        auto const latencyMicros = releaseLatencyMicros(bridged, lastFrameStartMicros);
+        Check(isPrompt(latencyMicros), "Lost repeat, bridged: braked %ldus after release", latencyMicros);
+    }
+
+    // Motor noise from the release onwards is not mistaken for lost repeats,
+    // even though it keeps the receiver seeing signal falls until the motor stops
+    long worstLatencyMicros = 0;
+    for (unsigned int seed = 1; seed <= 20; seed++)
+    {
+        std::vector<Mark> marks;
+        auto const lastFrameStartMicros = addHold(marks, VOLUME_DOWN_CODE, repeats);
+        auto const result = simulate(marks, 2, seed, marks.back().EndMicros);
+        auto const latencyMicros = releaseLatencyMicros(result, lastFrameStartMicros);
+        if (latencyMicros > worstLatencyMicros) worstLatencyMicros = latencyMicros;
+        Check(isPrompt(latencyMicros), "Release in motor noise (seed %u): braked %ldus after release", seed, latencyMicros);
+    }
+    printf("Worst release latency in motor noise: %.1fms\n", worstLatencyMicros / 1000.0);
+
+    // Nor is Poisson noise (1 signal fall per ms), whose gaps often match a repeat
+    // interval, mistaken for repeats. Otherwise the motor keeps running after the
+    // button is released. Noise this frequent also garbles most repeats, so when
+    // it runs with the motor, the motor may stutter, but must still stop promptly
+    worstLatencyMicros = 0;
+    for (unsigned int seed = 1; seed <= 20; seed++)
+    {
+        std::vector<Mark> marks;
+        auto const lastFrameStartMicros = addHold(marks, VOLUME_DOWN_CODE, repeats);
+        bool const fromRelease = seed % 2;
+        char const * const name = fromRelease ? "release" : "start";
+        auto const result = simulate(marks, 2, seed, fromRelease ? marks.back().EndMicros : 0, /*poissonNoise:*/true);
+        auto const latencyMicros = releaseLatencyMicros(result, lastFrameStartMicros);
+        if (latencyMicros > worstLatencyMicros) worstLatencyMicros = latencyMicros;
+        Check(!result.MovingAtEnd, "Poisson motor noise from the %s (seed %u): still moving", name, seed);
+        if (fromRelease)
+        {
+            Check(result.BrakeCount == 1, "Poisson motor noise from the release (seed %u): braked %lu times",
+                seed, result.BrakeCount);
+            Check(isPrompt(latencyMicros), "Poisson motor noise from the release (seed %u): braked %ldus after release",
+                seed, latencyMicros);
+        }
+        else
+        {
+            Check(latencyMicros <= static_cast<long>(MOVEMENT_TIMEOUT_MICROS + LATENCY_ALLOWANCE_MICROS),
+                "Poisson motor noise from the start (seed %u): braked %ldus after release", seed, latencyMicros);
+        }
+    }
+    printf("Worst release latency in Poisson motor noise: %.1fms\n", worstLatencyMicros / 1000.0);
+    return ExitCode();
+}
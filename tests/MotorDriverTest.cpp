@@ -0,0 +1,121 @@
+/**
+ * Checks the pin levels each bridge in MotorDriver.h encodes the motor
+ * outputs as, and that the servo's pulses are timed without blocking
+ */
+#include "MotorDriver.h"
+#include "TestUtils.h"
+
+using namespace MotorDriverUtils;
+using namespace TestUtils;
+
+namespace
+{
+    int const VOLUME_UP_PIN = 4;
+    int const VOLUME_DOWN_PIN = 3;
+    int const ENABLE_PIN = 5;
+
+    char const * const OUTPUT_NAMES[] = { "coast", "volume up", "volume down", "brake" };
+
+    struct Levels
+    {
+        bool Up;
+        bool Down;
+        bool Enable;
+    };
+
+    /**
+     * Sets each output in turn (including from every other output), checking the pins afterwards
+     *
+     * @param expected Pin levels for each output, indexed by MotorOutput. When the bridge
+     * coasts with its enable pin, it leaves the inputs as they were, so they are not checked
+     */
+    template <class TBridge> void checkBridge(char const * const name, int const enablePin, Levels const (& expected)[4])
+    {
+        bool const coastsWithEnable = enablePin != Hal::NO_PIN && !expected[MOTOR_COAST].Enable;
+        Hal::Host::Reset();
+        MotorDriver<TBridge> driver(MotorDriverConfig { VOLUME_UP_PIN, VOLUME_DOWN_PIN, enablePin, 0 });
+        for (int from = MOTOR_COAST; from <= MOTOR_BRAKE; from++)
+        {
+            for (int to = MOTOR_COAST; to <= MOTOR_BRAKE; to++)
+            {
+                driver.Set(static_cast<MotorOutput>(from));
+                driver.Set(static_cast<MotorOutput>(to));
+                bool const up = Hal::Host::GetOutputLevel(VOLUME_UP_PIN);
+                bool const down = Hal::Host::GetOutputLevel(VOLUME_DOWN_PIN);
+                Check((to == MOTOR_COAST && coastsWithEnable) || (up == expected[to].Up && down == expected[to].Down),
+                    "%s, %s to %s: inputs %d/%d, expected %d/%d", name, OUTPUT_NAMES[from], OUTPUT_NAMES[to],
+                    up, down, expected[to].Up, expected[to].Down);
+                if (enablePin == Hal::NO_PIN) continue;
+                bool const enable = Hal::Host::GetOutputLevel(enablePin);
+                Check(enable == expected[to].Enable, "%s, %s to %s: enable %d, expected %d",
+                    name, OUTPUT_NAMES[from], OUTPUT_NAMES[to], enable, expected[to].Enable);
+            }
+        }
+    }
+
+    /**
+     * @returns The width of the next pulse on the servo's pin, or zero if none starts within a period
+     */
+    unsigned long nextPulseMicros(MotorDriver<ServoBridge> & driver)
+    {
+        for (unsigned long waitedMicros = 0; waitedMicros <= SERVO_PERIOD_MICROS; waitedMicros += 10)
+        {
+            auto const startMicros = Hal::Micros();
+            driver.Tick();
+            Check(Hal::Micros() == startMicros, "Servo: Tick blocked for %luus", Hal::Micros() - startMicros);
+            if (Hal::Host::GetOutputLevel(VOLUME_UP_PIN))
+            {
+                unsigned long widthMicros = 0;
+                while (Hal::Host::GetOutputLevel(VOLUME_UP_PIN) && widthMicros <= SERVO_PERIOD_MICROS)
+                {
+                    Hal::Host::AdvanceMicros(1);
+                    widthMicros++;
+                }
+                return widthMicros;
+            }
+            Hal::Host::AdvanceMicros(10);
+        }
+        return 0;
+    }
+}
+
+int main()
+{
+    // Coast, volume up, volume down, brake
+    checkBridge<L298Bridge>("L298, ENA connected", ENABLE_PIN,
+        { { false, false, false }, { true, false, true }, { false, true, true }, { true, true, true } });
+    // Without ENA, coasting pulls both inputs LOW, which the L298 treats as a brake
+    checkBridge<L298Bridge>("L298, ENA tied HIGH", Hal::NO_PIN,
+        { { false, false, true }, { true, false, true }, { false, true, true }, { true, true, true } });
+    checkBridge<Tb6612Bridge>("TB6612, STBY connected", ENABLE_PIN,
+        { { false, false, false }, { true, false, true }, { false, true, true }, { true, true, true } });
+    checkBridge<Tb6612Bridge>("TB6612, STBY tied HIGH", Hal::NO_PIN,
+        { { false, false, true }, { true, false, true }, { false, true, true }, { true, true, true } });
+    checkBridge<Drv8833Bridge>("DRV8833, nSLEEP connected", ENABLE_PIN,
+        { { false, false, true }, { true, false, true }, { false, true, true }, { true, true, true } });
+    checkBridge<Drv8833Bridge>("DRV8833, nSLEEP tied HIGH", Hal::NO_PIN,
+        { { false, false, true }, { true, false, true }, { false, true, true }, { true, true, true } });
+
+    // The servo is sent full speed pulses when driven, neutral pulses when braking, and none when coasting
+    {
+        Hal::Host::Reset();
+        Hal::Host::AdvanceMicros(SERVO_PERIOD_MICROS);
+        MotorDriver<ServoBridge> driver(MotorDriverConfig { VOLUME_UP_PIN, VOLUME_UP_PIN, Hal::NO_PIN, 0 });
+        MotorOutput const outputs[] = { MOTOR_VOLUME_UP, MOTOR_VOLUME_DOWN, MOTOR_BRAKE, MOTOR_COAST };
+        unsigned long const expectedMicros[] =
+        {
+            SERVO_NEUTRAL_MICROS + SERVO_FULL_SPEED_OFFSET_MICROS,
+            SERVO_NEUTRAL_MICROS - SERVO_FULL_SPEED_OFFSET_MICROS,
+            SERVO_NEUTRAL_MICROS,
+            0
+        };
+        for (int i = 0; i < 4; i++)
+        {
+            driver.Set(outputs[i]);
+            auto const pulseMicros = nextPulseMicros(driver);
+            Check(pulseMicros == expectedMicros[i], "Servo, %s: %luus pulse, expected %luus",
+                OUTPUT_NAMES[outputs[i]], pulseMicros, expectedMicros[i]);
+        }
+    }
+    return ExitCode();
+}
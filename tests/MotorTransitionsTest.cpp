@@ -0,0 +1,245 @@
+/**
+ * Scripts every transition of the motor state machine, and checks the
+ * sequence of states and the motor outputs on entering each one
+ */
+#include <vector>
+#include "Simulation.h"
+#include "ManualInput.h"
+#include "VolumeMotorStateMachine.h"
+#include "TestUtils.h"
+
+using namespace ManualInputUtils;
+using namespace SimulationUtils;
+using namespace VolumeMotorUtils;
+using namespace TestUtils;
+
+namespace
+{
+    int const VOLUME_UP_PIN = 4;
+    int const VOLUME_DOWN_PIN = 3;
+    int const SLIP_SENSOR_PIN = 10;
+    unsigned long const VOLUME_UP_CODE = 0xFFA857;
+    unsigned long const VOLUME_DOWN_CODE = 0xFFE01F;
+    unsigned long const MILLIS = 1000UL;
+    unsigned long const SCENARIO_MICROS = 1000UL * MILLIS;
+    int const STATE_COUNT = MANUAL_OVERRIDE + 1;
+
+    char const * const STATE_NAMES[STATE_COUNT] =
+    {
+        "IDLE",
+        "VOLUME_INCREASING",
+        "VOLUME_DECREASING",
+        "BRAKING",
+        "REVERSING_TO_INCREASING",
+        "REVERSING_TO_DECREASING",
+        "MANUAL_OVERRIDE"
+    };
+
+    struct Transition
+    {
+        MotorStateId From;
+        MotorStateId To;
+    };
+
+    struct Entry
+    {
+        MotorStateId State;
+        bool VolumeUpHigh; // Level of the volume up pin on entering the state
+        bool VolumeDownHigh;
+    };
+
+    Entry const INCREASING { VOLUME_INCREASING, true, false };
+    Entry const DECREASING { VOLUME_DECREASING, false, true };
+    Entry const BRAKE { BRAKING, true, true };
+    Entry const REVERSE_TO_INCREASING { REVERSING_TO_INCREASING, true, true };
+    Entry const REVERSE_TO_DECREASING { REVERSING_TO_DECREASING, true, true };
+    Entry const OVERRIDE { MANUAL_OVERRIDE, false, false };
+    Entry const STOPPED { IDLE, false, false };
+
+    bool taken[STATE_COUNT][STATE_COUNT] = { };
+
+    /**
+     * Runs a scenario with the scripted packets, and the slip sensor pulsed at
+     * the given time (if any), from power-on
+     *
+     * @param reversalBrake Whether to brake when reversing, rather than reversing directly
+     */
+    void checkScenario(
+        char const * const name,
+        ScriptedIrReceiver & receiver,
+        std::vector<Entry> const & expected,
+        unsigned long const slipMicros = 0,
+        bool const reversalBrake = true)
+    {
+        Hal::Host::Reset();
+        VolumeMotorStateMachine motorStateMachine(
+            receiver,
+            VolumeMotorConfig
+            {
+                .VolumeUpCode = VOLUME_UP_CODE,
+                .VolumeDownCode = VOLUME_DOWN_CODE,
+                .VolumeUpPin = VOLUME_UP_PIN,
+                .VolumeDownPin = VOLUME_DOWN_PIN,
+                .BrakeDurationMicros = 100UL * MILLIS,
+                .MovementTimeoutMicros = 120UL * MILLIS,
+                .SoftStartMicros = 0,
+                .SupplySagMillivolts = 0,
+                .IdlePowerDownMicros = 0,
+                .StatusLedPin = Hal::NO_PIN,
+                .MaxMissedRepeats = 0,
+                .ReversalBrakeMicros = reversalBrake ? 50UL * MILLIS : 0,
+                .ReversalDeadTimeMicros = reversalBrake ? 1UL * MILLIS : 0,
+                .MotorDeadTimeMicros = 0,
+                .MotorEnablePin = Hal::NO_PIN,
+                .ManualHoldOffMicros = 200UL * MILLIS
+            });
+        SlipManualInput<SLIP_SENSOR_PIN> slipSensor;
+        slipSensor.Attach();
+        motorStateMachine.EnableManualOverride(slipSensor);
+        VirtualTimeDriver<VolumeMotorStateMachine> driver(motorStateMachine);
+
+        std::vector<Entry> actual;
+        MotorStateId previous = motorStateMachine.GetStateId();
+        driver.RunUntil(SCENARIO_MICROS, [&]()
+        {
+            if (slipMicros && Hal::Micros() >= slipMicros && !Hal::Host::GetOutputLevel(SLIP_SENSOR_PIN))
+            {
+                Hal::Host::SetInputLevel(SLIP_SENSOR_PIN, true);
+            }
+            auto const current = motorStateMachine.GetStateId();
+            if (current == previous) return true;
+            taken[previous][current] = true;
+            actual.push_back(Entry
+            {
+                current,
+                Hal::Host::GetOutputLevel(VOLUME_UP_PIN),
+                Hal::Host::GetOutputLevel(VOLUME_DOWN_PIN)
+            });
+            previous = current;
+            return true;
+        });
+
+        Check(actual.size() == expected.size(), "%s: %zu transitions, expected %zu", name, actual.size(), expected.size());
+        for (size_t i = 0; i < actual.size() && i < expected.size(); i++)
+        {
+            auto const & a = actual[i];
+            auto const & e = expected[i];
+            Check(a.State == e.State && a.VolumeUpHigh == e.VolumeUpHigh && a.VolumeDownHigh == e.VolumeDownHigh,
+                "%s, transition %zu: %s (%d, %d), expected %s (%d, %d)", name, i,
+                STATE_NAMES[a.State], a.VolumeUpHigh, a.VolumeDownHigh,
+                STATE_NAMES[e.State], e.VolumeUpHigh, e.VolumeDownHigh);
+        }
+    }
+}
+
+int main()
+{
+    // Released: brakes after the movement timeout, then rests
+    {
+        ScriptedIrReceiver receiver;
+        receiver.ScheduleHold(10UL * MILLIS, VOLUME_UP_CODE, 2);
+        checkScenario("Volume up", receiver, { INCREASING, BRAKE, STOPPED });
+    }
+    {
+        ScriptedIrReceiver receiver;
+        receiver.ScheduleHold(10UL * MILLIS, VOLUME_DOWN_CODE, 2);
+        checkScenario("Volume down", receiver, { DECREASING, BRAKE, STOPPED });
+    }
+
+    // A packet while braking restarts the motor in the last code's direction
+    {
+        ScriptedIrReceiver receiver;
+        receiver.ScheduleCode(10UL * MILLIS, VOLUME_UP_CODE);
+        receiver.ScheduleRepeat(160UL * MILLIS);
+        receiver.ScheduleCode(310UL * MILLIS, VOLUME_DOWN_CODE);
+        checkScenario("Restarted while braking", receiver,
+            { INCREASING, BRAKE, INCREASING, BRAKE, DECREASING, BRAKE, STOPPED });
+    }
+
+    // Each reversal brakes first, and a change of mind restarts it
+    {
+        ScriptedIrReceiver receiver;
+        receiver.ScheduleCode(10UL * MILLIS, VOLUME_UP_CODE);
+        receiver.ScheduleCode(60UL * MILLIS, VOLUME_DOWN_CODE);
+        receiver.ScheduleCode(80UL * MILLIS, VOLUME_UP_CODE);
+        receiver.ScheduleCode(180UL * MILLIS, VOLUME_DOWN_CODE);
+        receiver.ScheduleCode(280UL * MILLIS, VOLUME_UP_CODE);
+        receiver.ScheduleCode(300UL * MILLIS, VOLUME_DOWN_CODE);
+        checkScenario("Reversals", receiver,
+            {
+                INCREASING, // 10ms
+                REVERSE_TO_DECREASING, // 60ms
+                REVERSE_TO_INCREASING, // 80ms
+                INCREASING, // 131ms
+                REVERSE_TO_DECREASING, // 180ms
+                DECREASING, // 231ms
+                REVERSE_TO_INCREASING, // 280ms
+                REVERSE_TO_DECREASING, // 300ms
+                DECREASING, // 351ms
+                BRAKE, // 420ms
+                STOPPED // 520ms
+            });
+    }
+
+    // Without a reversal brake, the motor reverses directly
+    {
+        ScriptedIrReceiver receiver;
+        receiver.ScheduleCode(10UL * MILLIS, VOLUME_UP_CODE);
+        receiver.ScheduleCode(60UL * MILLIS, VOLUME_DOWN_CODE);
+        receiver.ScheduleCode(120UL * MILLIS, VOLUME_UP_CODE);
+        checkScenario("Direct reversals", receiver, { INCREASING, DECREASING, INCREASING, BRAKE, STOPPED }, 0, false);
+    }
+
+    // Turning the knob by hand coasts the motor from any state that drives or brakes it
+    {
+        ScriptedIrReceiver receiver;
+        receiver.ScheduleHold(10UL * MILLIS, VOLUME_UP_CODE, 3);
+        checkScenario("Override while increasing", receiver, { INCREASING, OVERRIDE, STOPPED }, 50UL * MILLIS);
+    }
+    {
+        ScriptedIrReceiver receiver;
+        receiver.ScheduleHold(10UL * MILLIS, VOLUME_DOWN_CODE, 3);
+        checkScenario("Override while decreasing", receiver, { DECREASING, OVERRIDE, STOPPED }, 50UL * MILLIS);
+    }
+    {
+        ScriptedIrReceiver receiver;
+        receiver.ScheduleCode(10UL * MILLIS, VOLUME_UP_CODE);
+        checkScenario("Override while braking", receiver, { INCREASING, BRAKE, OVERRIDE, STOPPED }, 150UL * MILLIS);
+    }
+    {
+        ScriptedIrReceiver receiver;
+        receiver.ScheduleCode(10UL * MILLIS, VOLUME_DOWN_CODE);
+        receiver.ScheduleCode(60UL * MILLIS, VOLUME_UP_CODE);
+        checkScenario("Override while reversing to increasing", receiver,
+            { DECREASING, REVERSE_TO_INCREASING, OVERRIDE, STOPPED }, 80UL * MILLIS);
+    }
+    {
+        ScriptedIrReceiver receiver;
+        receiver.ScheduleCode(10UL * MILLIS, VOLUME_UP_CODE);
+        receiver.ScheduleCode(60UL * MILLIS, VOLUME_DOWN_CODE);
+        checkScenario("Override while reversing to decreasing", receiver,
+            { INCREASING, REVERSE_TO_DECREASING, OVERRIDE, STOPPED }, 80UL * MILLIS);
+    }
+
+    // Every transition that the state machine can take, taken above
+    Transition const allTransitions[] =
+    {
+        { IDLE, VOLUME_INCREASING }, { IDLE, VOLUME_DECREASING },
+        { VOLUME_INCREASING, VOLUME_DECREASING }, { VOLUME_INCREASING, BRAKING },
+        { VOLUME_INCREASING, REVERSING_TO_DECREASING }, { VOLUME_INCREASING, MANUAL_OVERRIDE },
+        { VOLUME_DECREASING, VOLUME_INCREASING }, { VOLUME_DECREASING, BRAKING },
+        { VOLUME_DECREASING, REVERSING_TO_INCREASING }, { VOLUME_DECREASING, MANUAL_OVERRIDE },
+        { BRAKING, IDLE }, { BRAKING, VOLUME_INCREASING }, { BRAKING, VOLUME_DECREASING }, { BRAKING, MANUAL_OVERRIDE },
+        { REVERSING_TO_INCREASING, VOLUME_INCREASING }, { REVERSING_TO_INCREASING, REVERSING_TO_DECREASING },
+        { REVERSING_TO_INCREASING, MANUAL_OVERRIDE },
+        { REVERSING_TO_DECREASING, VOLUME_DECREASING }, { REVERSING_TO_DECREASING, REVERSING_TO_INCREASING },
+        { REVERSING_TO_DECREASING, MANUAL_OVERRIDE },
+        { MANUAL_OVERRIDE, IDLE }
+    };
+    for (auto const transition : allTransitions)
+    {
+        Check(taken[transition.From][transition.To], "Never taken: %s -> %s",
+            STATE_NAMES[transition.From], STATE_NAMES[transition.To]);
+    }
+    return ExitCode();
+}
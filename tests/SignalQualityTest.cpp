@@ -0,0 +1,63 @@
+/**
+ * Checks that the invalid frame percentage counts abandoned codes against
+ * decoded codes only (not repeats), and that the status LED can be left
+ * unconnected with Hal::NO_PIN, while pin 0 still blinks
+ */
+#include <vector>
+#include "BatchIrReceiver.h"
+#include "TestUtils.h"
+
+using namespace IrReceiverUtils;
+using namespace TestUtils;
+
+namespace
+{
+    unsigned long const CODE = 0xFFA857UL;
+    int const CODES = 4;
+    int const REPEATS_PER_CODE = 5;
+
+    void capture(BatchIrReceiver & receiver, std::vector<IrSymbol> const & symbols)
+    {
+        Hal::Host::AdvanceMicros(REPEAT_PERIOD_MICROS);
+        receiver.OnCapture(symbols.data(), symbols.size());
+        IrPacket packet;
+        while (receiver.TryGetPacket(packet)) { }
+    }
+}
+
+int main()
+{
+    Hal::Host::Reset();
+    BatchIrReceiver receiver;
+    std::vector<IrSymbol> codeSymbols(SYMBOLS_PER_CODE);
+    EncodeNecCode(CODE, codeSymbols.data());
+    std::vector<IrSymbol> repeatSymbols(SYMBOLS_PER_REPEAT);
+    EncodeNecRepeat(repeatSymbols.data());
+    // A code abandoned after a few bits, by a space too long for any bit
+    std::vector<IrSymbol> abandonedSymbols(codeSymbols.begin(), codeSymbols.begin() + 5);
+    abandonedSymbols.back().SpaceMicros = 3 * ONE_SPACE_MICROS;
+    abandonedSymbols.push_back(IrSymbol { BIT_MARK_MICROS, 0 });
+
+    for (int code = 0; code < CODES; code++)
+    {
+        capture(receiver, codeSymbols);
+        for (int repeat = 0; repeat < REPEATS_PER_CODE; repeat++) capture(receiver, repeatSymbols);
+    }
+    capture(receiver, abandonedSymbols);
+
+    auto const quality = receiver.GetSignalQuality();
+    byte const expectedPercent = 100 / (CODES + 1);
+    Check(quality.InvalidFramePercent == expectedPercent, "Invalid frames: %u%%, expected %u%%",
+        quality.InvalidFramePercent, expectedPercent);
+
+    // Not connected: nothing is written
+    GradeBlinker unconnected(Hal::NO_PIN);
+    unconnected.Start(3);
+    Check(!unconnected.IsBlinking(), "Unconnected status LED blinked");
+
+    // Pin 0 is a pin like any other
+    GradeBlinker pinZero(0);
+    pinZero.Start(3);
+    Check(pinZero.IsBlinking() && Hal::Host::GetOutputLevel(0), "Status LED on pin 0 did not blink");
+    return ExitCode();
+}
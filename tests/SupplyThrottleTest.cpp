@@ -0,0 +1,117 @@
+/**
+ * Checks that the motor drive is throttled while the supply sags below
+ * VolumeMotorConfig::SupplySagMillivolts, never below MINIMUM_THROTTLED_DUTY,
+ * and recovers to full drive once the supply does
+ */
+#include "Simulation.h"
+#include "VolumeMotorStateMachine.h"
+#include "TestUtils.h"
+
+using namespace SimulationUtils;
+using namespace VolumeMotorUtils;
+using namespace TestUtils;
+
+namespace
+{
+    int const VOLUME_UP_PIN = 4;
+    int const VOLUME_DOWN_PIN = 3;
+    unsigned long const VOLUME_UP_CODE = 0xFFA857;
+    unsigned long const VOLUME_DOWN_CODE = 0xFFE01F;
+    unsigned int const SUPPLY_SAG_MILLIVOLTS = 4500;
+    unsigned int const NORMAL_MILLIVOLTS = 5000;
+    unsigned int const SAGGING_MILLIVOLTS = 4200;
+    // Time to settle after the supply changes, long enough for the duty to step
+    // between full and minimum (one step per supply reading, one reading per tick)
+    unsigned long const SETTLE_MICROS = 200UL * 1000UL;
+    unsigned long const MEASURE_MICROS = 10 * PWM_PERIOD_MICROS;
+    // Duty is measured by sampling the drive once per tick
+    double const DUTY_TOLERANCE = static_cast<double>(DEFAULT_TICK_MICROS) / PWM_PERIOD_MICROS;
+
+    struct Measurement
+    {
+        double Duty; // Fraction of the time the motor was driven
+        bool Moving; // Whether the motor stayed in VOLUME_INCREASING throughout
+    };
+
+    Measurement measure(
+        VirtualTimeDriver<VolumeMotorStateMachine> & driver,
+        VolumeMotorStateMachine const & motorStateMachine,
+        unsigned long const durationMicros)
+    {
+        unsigned long ticks = 0;
+        unsigned long drivenTicks = 0;
+        bool moving = true;
+        driver.RunFor(durationMicros, [&]()
+        {
+            ticks++;
+            if (Hal::Host::GetOutputLevel(VOLUME_UP_PIN) && !Hal::Host::GetOutputLevel(VOLUME_DOWN_PIN)) drivenTicks++;
+            moving = moving && motorStateMachine.GetStateId() == VOLUME_INCREASING;
+            return true;
+        });
+        return Measurement { static_cast<double>(drivenTicks) / ticks, moving };
+    }
+
+    void checkDuty(Measurement const measurement, byte const expectedDuty, char const * const name)
+    {
+        double const expected = static_cast<double>(expectedDuty) / FULL_DUTY;
+        Check(measurement.Moving, "%s: motor stopped", name);
+        Check(measurement.Duty >= expected - DUTY_TOLERANCE && measurement.Duty <= expected + DUTY_TOLERANCE,
+            "%s: duty %.3f, expected %.3f", name, measurement.Duty, expected);
+    }
+
+    void run(unsigned int const supplySagMillivolts)
+    {
+        Hal::Host::Reset();
+        ScriptedIrReceiver receiver;
+        // Held for long enough to cover every phase below
+        receiver.ScheduleHold(10UL * 1000UL, VOLUME_UP_CODE, 20);
+        VolumeMotorStateMachine motorStateMachine(
+            receiver,
+            VolumeMotorConfig
+            {
+                .VolumeUpCode = VOLUME_UP_CODE,
+                .VolumeDownCode = VOLUME_DOWN_CODE,
+                .VolumeUpPin = VOLUME_UP_PIN,
+                .VolumeDownPin = VOLUME_DOWN_PIN,
+                .BrakeDurationMicros = 100UL * 1000UL,
+                .MovementTimeoutMicros = 120UL * 1000UL,
+                .SoftStartMicros = 0,
+                .SupplySagMillivolts = supplySagMillivolts,
+                .IdlePowerDownMicros = 0,
+                .StatusLedPin = Hal::NO_PIN,
+                .MaxMissedRepeats = 0,
+                .ReversalBrakeMicros = 0,
+                .ReversalDeadTimeMicros = 0,
+                .MotorDeadTimeMicros = 0,
+                .MotorEnablePin = Hal::NO_PIN,
+                .ManualHoldOffMicros = 0
+            });
+        VirtualTimeDriver<VolumeMotorStateMachine> driver(motorStateMachine);
+        driver.RunUntil(20UL * 1000UL);
+
+        bool const monitored = supplySagMillivolts != 0;
+        checkDuty(measure(driver, motorStateMachine, SETTLE_MICROS), FULL_DUTY,
+            monitored ? "Normal supply" : "Normal supply, unmonitored");
+
+        Hal::Host::supplyMillivolts = SAGGING_MILLIVOLTS;
+        driver.RunFor(SETTLE_MICROS);
+        checkDuty(measure(driver, motorStateMachine, MEASURE_MICROS), monitored ? MINIMUM_THROTTLED_DUTY : FULL_DUTY,
+            monitored ? "Sagging supply" : "Sagging supply, unmonitored");
+        // The minimum holds however long the supply sags
+        driver.RunFor(5 * SETTLE_MICROS);
+        checkDuty(measure(driver, motorStateMachine, MEASURE_MICROS), monitored ? MINIMUM_THROTTLED_DUTY : FULL_DUTY,
+            monitored ? "Long sag" : "Long sag, unmonitored");
+
+        Hal::Host::supplyMillivolts = NORMAL_MILLIVOLTS;
+        driver.RunFor(SETTLE_MICROS);
+        checkDuty(measure(driver, motorStateMachine, MEASURE_MICROS), FULL_DUTY,
+            monitored ? "Recovered supply" : "Recovered supply, unmonitored");
+    }
+}
+
+int main()
+{
+    run(SUPPLY_SAG_MILLIVOLTS);
+    run(0);
+    return ExitCode();
+}
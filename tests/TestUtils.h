@@ -0,0 +1,38 @@
+#ifndef TEST_UTILS_H
+#define TEST_UTILS_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+/**
+ * Checks for the host tests. Each test is a program that runs its checks,
+ * and returns ExitCode() from main, so that ctest reports any failures
+ */
+namespace TestUtils
+{
+    inline int failures = 0;
+
+    /**
+     * Prints the description (printf style) if the condition does not hold
+     */
+    __attribute__((format(printf, 2, 3))) inline void Check(bool const condition, char const * const format, ...)
+    {
+        if (condition) return;
+        failures++;
+        printf("FAILED: ");
+        va_list arguments;
+        va_start(arguments, format);
+        vprintf(format, arguments);
+        va_end(arguments);
+        printf("\n");
+    }
+
+    inline int ExitCode()
+    {
+        if (failures) printf("%d check(s) failed\n", failures);
+        else printf("All checks passed\n");
+        return failures ? 1 : 0;
+    }
+}
+
+#endif //TEST_UTILS_H
\ No newline at end of file
@@ -0,0 +1,112 @@
+/**
+ * Checks the timing histogram bins (see TimingHistograms), at their edges,
+ * and for the intervals that a receiver accepts at the edges of its windows
+ */
+#define IR_TIMING_HISTOGRAMS
+#include <vector>
+#include "BatchIrReceiver.h"
+#include "TestUtils.h"
+
+using namespace IrReceiverUtils;
+using namespace TestUtils;
+
+namespace
+{
+    byte const LAST_BIN = TIMING_HISTOGRAM_BINS - 1;
+
+    /**
+     * The bin that a single interval, the given deviation from its nominal duration, is counted in
+     */
+    int binOf(TimingSymbol const symbol, unsigned long const nominalMicros, long const deviationMicros)
+    {
+        TimingHistograms histograms;
+        histograms.Record(symbol, static_cast<DecodeMicros>(nominalMicros + deviationMicros));
+        byte counts[TIMING_HISTOGRAM_BINS];
+        histograms.Read(symbol, counts);
+        for (byte bin = 0; bin < TIMING_HISTOGRAM_BINS; bin++)
+        {
+            if (counts[bin]) return bin;
+        }
+        return -1;
+    }
+
+    void checkBin(TimingSymbol const symbol, unsigned long const nominalMicros, long const deviationMicros, int const expectedBin)
+    {
+        auto const bin = binOf(symbol, nominalMicros, deviationMicros);
+        Check(bin == expectedBin, "%ldus from %luus: bin %d, expected %d", deviationMicros, nominalMicros, bin, expectedBin);
+    }
+
+    /**
+     * Symbols whose signal falls are the given intervals apart, as a capture peripheral would deliver them
+     */
+    std::vector<IrSymbol> symbolsFor(std::vector<unsigned long> const & intervalsMicros)
+    {
+        std::vector<IrSymbol> symbols { IrSymbol { AGC_MARK_MICROS, 0 } };
+        for (auto const intervalMicros : intervalsMicros)
+        {
+            symbols.back().SpaceMicros = intervalMicros - BIT_MARK_MICROS;
+            symbols.push_back(IrSymbol { BIT_MARK_MICROS, 0 });
+        }
+        return symbols;
+    }
+
+    void checkCounts(BatchIrReceiver & receiver, TimingSymbol const symbol, byte const bin, byte const expectedCount, char const * const name)
+    {
+        byte counts[TIMING_HISTOGRAM_BINS];
+        receiver.GetTimingHistograms().Read(symbol, counts);
+        for (byte i = 0; i < TIMING_HISTOGRAM_BINS; i++)
+        {
+            byte const expected = i == bin ? expectedCount : 0;
+            Check(counts[i] == expected, "%s: %u in bin %u, expected %u", name, counts[i], i, expected);
+        }
+    }
+}
+
+int main()
+{
+    // Bin edges, 16us apart from 128us short, with everything beyond counted in the outer bins
+    checkBin(TIMING_ZERO, ZERO_DURATION, -static_cast<long>(ZERO_DURATION), 0);
+    checkBin(TIMING_ZERO, ZERO_DURATION, -129, 0);
+    checkBin(TIMING_ZERO, ZERO_DURATION, -113, 0);
+    checkBin(TIMING_ZERO, ZERO_DURATION, -112, 1);
+    checkBin(TIMING_ONE, ONE_DURATION, -1, 7);
+    checkBin(TIMING_ONE, ONE_DURATION, 0, 8);
+    checkBin(TIMING_REPEAT, REPEAT_DURATION, 111, 14);
+    checkBin(TIMING_REPEAT, REPEAT_DURATION, 112, LAST_BIN);
+    checkBin(TIMING_AGC, AGC_DURATION, 5000, LAST_BIN);
+
+    // The edges of the default windows land in bins 3 and 13
+    checkBin(TIMING_ZERO, ZERO_DURATION, -static_cast<long>(HALF_WINDOW), 3);
+    checkBin(TIMING_ZERO, ZERO_DURATION, HALF_WINDOW, 13);
+
+    // A receiver records each interval it accepts: a code with its AGC and one
+    // bits at the long edge of their windows and its zero bits at the short edge,
+    // then a repeat at the short edge of its window
+    unsigned long const code = 0xFFA857UL;
+    byte ones = 0;
+    std::vector<unsigned long> intervals { AGC_DURATION + HALF_WINDOW };
+    for (byte bitIndex = BITS_PER_CODE; bitIndex > 0; bitIndex--)
+    {
+        bool const one = (code >> (bitIndex - 1)) & 1UL;
+        ones += one;
+        intervals.push_back(one ? ONE_DURATION + HALF_WINDOW : ZERO_DURATION - HALF_WINDOW);
+    }
+    Hal::Host::Reset();
+    BatchIrReceiver receiver;
+    auto const codeSymbols = symbolsFor(intervals);
+    receiver.OnCapture(codeSymbols.data(), codeSymbols.size());
+    IrPacket packet;
+    Check(receiver.TryGetPacket(packet) && packet.Code == code, "Code at the window edges: not received");
+    auto const repeatSymbols = symbolsFor({ REPEAT_DURATION - HALF_WINDOW });
+    receiver.OnCapture(repeatSymbols.data(), repeatSymbols.size());
+    Check(receiver.TryGetPacket(packet) && packet.IsRepeat, "Repeat at the window edge: not received");
+
+    checkCounts(receiver, TIMING_AGC, 13, 1, "AGC");
+    checkCounts(receiver, TIMING_ONE, 13, ones, "One bits");
+    checkCounts(receiver, TIMING_ZERO, 3, BITS_PER_CODE - ones, "Zero bits");
+    checkCounts(receiver, TIMING_REPEAT, 3, 1, "Repeat");
+
+    receiver.GetTimingHistograms().Clear();
+    checkCounts(receiver, TIMING_AGC, 0, 0, "Cleared");
+    return ExitCode();
+}
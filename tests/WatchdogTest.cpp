@@ -0,0 +1,90 @@
+/**
+ * Hangs the main loop under the simulated watchdog, and checks that each
+ * timeout stops the motor, that the loop picks up where it left off after
+ * recovering before the reset, and that only real resets are counted
+ */
+#include "Simulation.h"
+#include "VolumeMotorStateMachine.h"
+#include "TestUtils.h"
+
+using namespace SimulationUtils;
+using namespace VolumeMotorUtils;
+using namespace TestUtils;
+
+namespace
+{
+    int const VOLUME_UP_PIN = 4;
+    int const VOLUME_DOWN_PIN = 3;
+    unsigned long const VOLUME_UP_CODE = 0xFFA857;
+    unsigned long const VOLUME_DOWN_CODE = 0xFFE01F;
+    unsigned long const MILLIS = 1000UL;
+    // Longer than one timeout (64ms), but shorter than two, or than the movement timeout
+    unsigned long const RECOVERED_HANG_MICROS = 80UL * MILLIS;
+    unsigned long const FATAL_HANG_MICROS = 150UL * MILLIS;
+
+    void checkOutputs(char const * const name, bool const volumeUpHigh, bool const volumeDownHigh)
+    {
+        bool const up = Hal::Host::GetOutputLevel(VOLUME_UP_PIN);
+        bool const down = Hal::Host::GetOutputLevel(VOLUME_DOWN_PIN);
+        Check(up == volumeUpHigh && down == volumeDownHigh, "%s: outputs (%d, %d), expected (%d, %d)",
+            name, up, down, volumeUpHigh, volumeDownHigh);
+    }
+}
+
+int main()
+{
+    Hal::Host::Reset();
+    ScriptedIrReceiver receiver;
+    // Held throughout
+    receiver.ScheduleHold(10UL * MILLIS, VOLUME_UP_CODE, 20);
+    VolumeMotorStateMachine motorStateMachine(
+        receiver,
+        VolumeMotorConfig
+        {
+            .VolumeUpCode = VOLUME_UP_CODE,
+            .VolumeDownCode = VOLUME_DOWN_CODE,
+            .VolumeUpPin = VOLUME_UP_PIN,
+            .VolumeDownPin = VOLUME_DOWN_PIN,
+            .BrakeDurationMicros = 100UL * MILLIS,
+            .MovementTimeoutMicros = 120UL * MILLIS,
+            .SoftStartMicros = 0,
+            .SupplySagMillivolts = 0,
+            .IdlePowerDownMicros = 0,
+            .StatusLedPin = Hal::NO_PIN,
+            .MaxMissedRepeats = 0,
+            .ReversalBrakeMicros = 0,
+            .ReversalDeadTimeMicros = 0,
+            .MotorDeadTimeMicros = 0,
+            .MotorEnablePin = Hal::NO_PIN,
+            .ManualHoldOffMicros = 0
+        });
+    motorStateMachine.EnableWatchdog(Hal::WATCHDOG_60MS);
+    VirtualTimeDriver<VolumeMotorStateMachine> driver(motorStateMachine);
+
+    driver.RunUntil(50UL * MILLIS);
+    checkOutputs("Moving", true, false);
+
+    // Each hang that the loop recovers from stops the motor, until the next tick
+    for (int hang = 1; hang <= 2; hang++)
+    {
+        Hal::Host::AdvanceMicros(RECOVERED_HANG_MICROS);
+        checkOutputs(hang == 1 ? "First hang" : "Second hang", false, false);
+        driver.Step();
+        Check(motorStateMachine.GetStateId() == VOLUME_INCREASING, "Recovered: motor stopped");
+        checkOutputs("Recovered", true, false);
+        driver.RunFor(50UL * MILLIS);
+    }
+    Check(Hal::Host::watchdogResetCount == 0, "Recovered hangs: %lu resets", Hal::Host::watchdogResetCount);
+
+    Hal::Host::AdvanceMicros(FATAL_HANG_MICROS);
+    Check(Hal::Host::watchdogResetCount == 1, "Fatal hang: %lu resets, expected 1", Hal::Host::watchdogResetCount);
+    checkOutputs("Fatal hang", false, false);
+
+    // Only the reset is counted, on the next start
+    Check(WatchdogUtils::GetResetCount() == 0, "Counted before the next start");
+    motorStateMachine.EnableWatchdog(Hal::WATCHDOG_60MS);
+    Check(WatchdogUtils::GetResetCount() == 1, "Reset count %u, expected 1", WatchdogUtils::GetResetCount());
+    motorStateMachine.EnableWatchdog(Hal::WATCHDOG_60MS);
+    Check(WatchdogUtils::GetResetCount() == 1, "Reset counted twice");
+    return ExitCode();
+}
@@ -0,0 +1,362 @@
+/**
+ * Bounded model checker for the motor state machine
+ *
+ * Enumerates every sequence of packet arrivals (codes, repeats, garbled
+ * frames or silence) and gaps between them, up to a depth, replays each
+ * through VolumeMotorStateMachine in simulated time, and checks these
+ * properties after every tick:
+ *
+ *   1. Both outputs are only HIGH (braking the motor) while braking,
+ *      or while braking at the start of a reversal
+ *   2. The motor is never driven for longer than the movement timeout
+ *      (plus bridged repeats) after the last code or repeat for its direction
+ *   3. The motor is only driven in the direction of the last volume code received
+ *
+ * Volume up and volume down are handled by the same template, mirrored, so
+ * only sequences whose first volume code is volume up are checked. Pass
+ * --check-symmetry to also replay the mirror image of each sequence, and
+ * check that its trace is the mirror image too
+ *
+ * Build and run on the host, from the repository root:
+ *   g++ -std=gnu++17 -O2 -Wall -Wextra -DHAL_HOST -I. tools/ModelChecker.cpp -o ModelChecker
+ *   ./ModelChecker [--depth N] [--check-symmetry]
+ */
+#include <chrono>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "Simulation.h"
+#include "VolumeMotorStateMachine.h"
+
+using namespace SimulationUtils;
+using namespace VolumeMotorUtils;
+
+namespace
+{
+    int const VOLUME_UP_PIN = 4;
+    int const VOLUME_DOWN_PIN = 3;
+    unsigned long const VOLUME_UP_CODE = 0xFFA857;
+    unsigned long const VOLUME_DOWN_CODE = 0xFFE01F;
+    unsigned long const OTHER_CODE = 0xFF629D;
+    // Coarser than loop() on the Arduino, to keep runs short. The properties
+    // do not depend on the tick period, other than through the allowances below
+    unsigned long const TICK_MICROS = 500UL;
+    // Simulated time after the last event, for the motor to come to rest
+    unsigned long const SETTLE_MICROS = 600UL * 1000UL;
+    int const DEFAULT_DEPTH = 4;
+    int const MAX_DEPTH = 8;
+
+    unsigned long const MOVEMENT_TIMEOUT_MICROS = 120UL * 1000UL;
+
+    /**
+     * As in the sketch, apart from the number of missed repeats to bridge. Without
+     * bridging, the timeout property is checked to within a tick. With it, the
+     * bridged repeats loosen it, but the bridging logic is exercised
+     */
+    VolumeMotorConfig makeConfig(byte const maxMissedRepeats)
+    {
+        return VolumeMotorConfig
+        {
+            .VolumeUpCode = VOLUME_UP_CODE,
+            .VolumeDownCode = VOLUME_DOWN_CODE,
+            .VolumeUpPin = VOLUME_UP_PIN,
+            .VolumeDownPin = VOLUME_DOWN_PIN,
+            .BrakeDurationMicros = 100UL * 1000UL,
+            .MovementTimeoutMicros = MOVEMENT_TIMEOUT_MICROS,
+            .SoftStartMicros = 20UL * 1000UL,
+            .SupplySagMillivolts = 0,
+            .IdlePowerDownMicros = 0,
+            .StatusLedPin = Hal::NO_PIN,
+            .MaxMissedRepeats = maxMissedRepeats,
+            .ReversalBrakeMicros = 50UL * 1000UL,
+            .ReversalDeadTimeMicros = 1000UL,
+            .MotorDeadTimeMicros = 0,
+            .MotorEnablePin = Hal::NO_PIN,
+            .ManualHoldOffMicros = 0
+        };
+    }
+
+    byte const MAX_MISSED_REPEATS_CHECKED[] = { 0, 1 };
+
+    enum Event
+    {
+        SILENCE,
+        UP_CODE,
+        DOWN_CODE,
+        OTHER,
+        REPEAT,
+        GARBLED, // A garbled frame, which the receiver sees start but delivers no packet for
+        EVENT_COUNT
+    };
+
+    char const * const EVENT_NAMES[EVENT_COUNT] = { "silence", "up", "down", "other", "repeat", "garbled" };
+
+    // Gaps before each event: the next tick, half a repeat period, a repeat
+    // period, just over the movement timeout, and longer than braking
+    unsigned long const GAPS_MICROS[] =
+    {
+        TICK_MICROS,
+        REPEAT_PERIOD_MICROS / 2,
+        REPEAT_PERIOD_MICROS,
+        MOVEMENT_TIMEOUT_MICROS + TICK_MICROS,
+        250UL * 1000UL
+    };
+    int const GAP_COUNT = sizeof(GAPS_MICROS) / sizeof(GAPS_MICROS[0]);
+    int const CHOICE_COUNT = EVENT_COUNT * GAP_COUNT;
+
+    enum Property
+    {
+        BRAKE_OUTSIDE_BRAKING,
+        DRIVEN_PAST_TIMEOUT,
+        DRIVEN_AGAINST_COMMAND,
+        MIRROR_MISMATCH,
+        PROPERTY_COUNT
+    };
+
+    char const * const PROPERTY_NAMES[PROPERTY_COUNT] =
+    {
+        "Both outputs HIGH outside of braking",
+        "Driven past the movement timeout",
+        "Driven against the last volume code",
+        "Mirrored sequence gave a different trace"
+    };
+
+    struct Step
+    {
+        Event Kind;
+        unsigned long GapMicros;
+    };
+
+    /**
+     * Outputs and state after each tick
+     */
+    struct TraceEntry
+    {
+        MotorStateId State;
+        bool Up;
+        bool Down;
+    };
+
+    // Marks a property that was not violated
+    unsigned long const NO_VIOLATION = ULONG_MAX;
+
+    Event mirror(Event const event)
+    {
+        return event == UP_CODE ? DOWN_CODE : event == DOWN_CODE ? UP_CODE : event;
+    }
+
+    MotorStateId mirror(MotorStateId const state)
+    {
+        switch (state)
+        {
+            case VOLUME_INCREASING: return VOLUME_DECREASING;
+            case VOLUME_DECREASING: return VOLUME_INCREASING;
+            case REVERSING_TO_INCREASING: return REVERSING_TO_DECREASING;
+            case REVERSING_TO_DECREASING: return REVERSING_TO_INCREASING;
+            default: return state;
+        }
+    }
+
+    /**
+     * True iff. the sequence is the one of its mirror pair that is checked:
+     * its first volume code (if any) is volume up
+     */
+    bool isCanonical(std::vector<Step> const & steps)
+    {
+        for (auto const & step : steps)
+        {
+            if (step.Kind == UP_CODE) return true;
+            if (step.Kind == DOWN_CODE) return false;
+        }
+        return true;
+    }
+
+    /**
+     * Replay a sequence, recording the trace and the time of the first violation of each property
+     *
+     * @param outViolationMicros Must be filled with NO_VIOLATION
+     */
+    void replay(
+        byte const maxMissedRepeats,
+        std::vector<Step> const & steps,
+        std::vector<TraceEntry> & outTrace,
+        unsigned long * const outViolationMicros)
+    {
+        Hal::Host::Reset();
+        ScriptedIrReceiver receiver;
+        std::vector<Event> arrivals; // Events that deliver a packet, in order
+        unsigned long eventMicros = 0;
+        for (auto const & step : steps)
+        {
+            eventMicros += step.GapMicros;
+            switch (step.Kind)
+            {
+                case UP_CODE: receiver.ScheduleCode(eventMicros, VOLUME_UP_CODE); break;
+                case DOWN_CODE: receiver.ScheduleCode(eventMicros, VOLUME_DOWN_CODE); break;
+                case OTHER: receiver.ScheduleCode(eventMicros, OTHER_CODE); break;
+                case REPEAT: receiver.ScheduleRepeat(eventMicros); break;
+                case GARBLED: receiver.ScheduleGarbledFrame(eventMicros); break;
+                default: continue;
+            }
+            if (step.Kind != GARBLED) arrivals.push_back(step.Kind);
+        }
+
+        VolumeMotorStateMachine motorStateMachine(receiver, makeConfig(maxMissedRepeats));
+        VirtualTimeDriver<VolumeMotorStateMachine> driver(motorStateMachine, TICK_MICROS);
+
+        // Packets are read at most one per tick, so deliveries are
+        // followed through the receiver's pending count
+        size_t delivered = 0;
+        Event lastVolumeCode = SILENCE;
+        unsigned long lastUpMicros = 0; // Last up code, or repeat
+        unsigned long lastDownMicros = 0;
+        unsigned long const allowanceMicros = MOVEMENT_TIMEOUT_MICROS
+            + maxMissedRepeats * REPEAT_PERIOD_MICROS
+            + TICK_MICROS;
+        auto const violate = [&](Property const property)
+        {
+            if (outViolationMicros[property] == NO_VIOLATION) outViolationMicros[property] = Hal::Micros();
+        };
+
+        outTrace.clear();
+        driver.RunUntil(eventMicros + SETTLE_MICROS, [&]()
+        {
+            auto const currentMicros = Hal::Micros();
+            while (delivered < arrivals.size() - receiver.GetPendingCount())
+            {
+                auto const arrival = arrivals[delivered++];
+                if (arrival == UP_CODE || arrival == DOWN_CODE) lastVolumeCode = arrival;
+                if (arrival == UP_CODE || arrival == REPEAT) lastUpMicros = currentMicros;
+                if (arrival == DOWN_CODE || arrival == REPEAT) lastDownMicros = currentMicros;
+            }
+
+            auto const state = motorStateMachine.GetStateId();
+            bool const up = Hal::Host::GetOutputLevel(VOLUME_UP_PIN);
+            bool const down = Hal::Host::GetOutputLevel(VOLUME_DOWN_PIN);
+            outTrace.push_back(TraceEntry { state, up, down });
+
+            if (up && down && state != BRAKING && state != REVERSING_TO_INCREASING && state != REVERSING_TO_DECREASING)
+            {
+                violate(BRAKE_OUTSIDE_BRAKING);
+            }
+            if (up != down)
+            {
+                if (currentMicros - (up ? lastUpMicros : lastDownMicros) > allowanceMicros) violate(DRIVEN_PAST_TIMEOUT);
+                if (lastVolumeCode != (up ? UP_CODE : DOWN_CODE)) violate(DRIVEN_AGAINST_COMMAND);
+            }
+            return true;
+        });
+    }
+
+    bool isMirrorTrace(std::vector<TraceEntry> const & trace, std::vector<TraceEntry> const & mirrorTrace)
+    {
+        if (trace.size() != mirrorTrace.size()) return false;
+        for (size_t i = 0; i < trace.size(); i++)
+        {
+            if (mirror(trace[i].State) != mirrorTrace[i].State
+                || trace[i].Up != mirrorTrace[i].Down
+                || trace[i].Down != mirrorTrace[i].Up) return false;
+        }
+        return true;
+    }
+
+    void printSequence(std::vector<Step> const & steps)
+    {
+        unsigned long micros = 0;
+        for (auto const & step : steps)
+        {
+            micros += step.GapMicros;
+            printf("    %7.1fms %s\n", micros / 1000.0, EVENT_NAMES[step.Kind]);
+        }
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    int depth = DEFAULT_DEPTH;
+    bool checkSymmetry = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--depth") && i + 1 < argc) depth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--check-symmetry")) checkSymmetry = true;
+        else
+        {
+            fprintf(stderr, "Usage: %s [--depth N] [--check-symmetry]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (depth < 1 || depth > MAX_DEPTH)
+    {
+        fprintf(stderr, "Depth must be between 1 and %d\n", MAX_DEPTH);
+        return 2;
+    }
+
+    unsigned long sequences = 0;
+    unsigned long skipped = 0;
+    unsigned long counterexamples[PROPERTY_COUNT] = { };
+    std::vector<Step> steps(depth);
+    std::vector<TraceEntry> trace;
+    std::vector<TraceEntry> mirrorTrace;
+    std::vector<int> choices(depth, 0);
+
+    auto const start = std::chrono::steady_clock::now();
+    while (true)
+    {
+        for (int i = 0; i < depth; i++)
+        {
+            steps[i] = Step { static_cast<Event>(choices[i] % EVENT_COUNT), GAPS_MICROS[choices[i] / EVENT_COUNT] };
+        }
+
+        if (!isCanonical(steps)) skipped++;
+        else for (auto const maxMissedRepeats : MAX_MISSED_REPEATS_CHECKED)
+        {
+            sequences++;
+            unsigned long violationMicros[PROPERTY_COUNT];
+            for (auto & micros : violationMicros) micros = NO_VIOLATION;
+            replay(maxMissedRepeats, steps, trace, violationMicros);
+
+            if (checkSymmetry)
+            {
+                auto mirrorSteps = steps;
+                for (auto & step : mirrorSteps) step.Kind = mirror(step.Kind);
+                unsigned long mirrorViolationMicros[PROPERTY_COUNT];
+                for (auto & micros : mirrorViolationMicros) micros = NO_VIOLATION;
+                replay(maxMissedRepeats, mirrorSteps, mirrorTrace, mirrorViolationMicros);
+                if (!isMirrorTrace(trace, mirrorTrace)) violationMicros[MIRROR_MISMATCH] = 0;
+            }
+
+            for (int property = 0; property < PROPERTY_COUNT; property++)
+            {
+                if (violationMicros[property] == NO_VIOLATION) continue;
+                if (!counterexamples[property]++)
+                {
+                    printf(
+                        "Counterexample: %s, at %.1fms, bridging up to %d missed repeats\n",
+                        PROPERTY_NAMES[property],
+                        violationMicros[property] / 1000.0,
+                        maxMissedRepeats);
+                    printSequence(steps);
+                }
+            }
+        }
+
+        // Next sequence, as an odometer over the choices
+        int position = depth - 1;
+        while (position >= 0 && ++choices[position] == CHOICE_COUNT) choices[position--] = 0;
+        if (position < 0) break;
+    }
+    std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+
+    printf("Depth %d: %lu runs of %lu sequences checked, %lu mirror images skipped, in %.1fs\n",
+        depth, sequences, sequences / (sizeof(MAX_MISSED_REPEATS_CHECKED) / sizeof(MAX_MISSED_REPEATS_CHECKED[0])), skipped, elapsed.count());
+    int failed = 0;
+    for (int property = 0; property < PROPERTY_COUNT; property++)
+    {
+        if (property == MIRROR_MISMATCH && !checkSymmetry) continue;
+        printf("%-42s %s (%lu)\n", PROPERTY_NAMES[property], counterexamples[property] ? "FAILED" : "holds", counterexamples[property]);
+        if (counterexamples[property]) failed++;
+    }
+    return failed ? 1 : 0;
+}
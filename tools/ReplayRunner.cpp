@@ -0,0 +1,95 @@
+/**
+ * Replays a corpus of IR capture files through the receiver and motor
+ * state machine, in parallel, and prints a combined report
+ * See CorpusReplay.h for the capture file format
+ *
+ * Build and run on the host, from the repository root:
+ *   g++ -std=gnu++17 -O2 -Wall -Wextra -pthread -DHAL_HOST -I. tools/ReplayRunner.cpp -o ReplayRunner
+ *   ./ReplayRunner [--threads N] [--max-missed-repeats N] capture1.txt capture2.txt ...
+ *
+ * Exits with a non-zero status if any capture could not be read or parsed,
+ * or if an option's value is not a number in its range
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CorpusReplay.h"
+
+using namespace CorpusReplayUtils;
+
+namespace
+{
+    unsigned long const MAX_THREADS = 1024;
+
+    /**
+     * Parse an option's value as a decimal number, rejecting signs,
+     * trailing characters and values outside [min, max]
+     */
+    bool parseCount(char const * const text, unsigned long const min, unsigned long const max, unsigned long & outValue)
+    {
+        // strtoul would accept a sign (and whitespace), and negate the value
+        if (!isdigit(static_cast<unsigned char>(*text))) return false;
+        char * end;
+        errno = 0;
+        unsigned long const value = strtoul(text, &end, 10);
+        if (errno || *end || value < min || value > max) return false;
+        outValue = value;
+        return true;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    unsigned int threadCount = std::thread::hardware_concurrency();
+    ReplayOptions options;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        unsigned long value;
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            if (!parseCount(argv[++i], 1, MAX_THREADS, value))
+            {
+                fprintf(stderr, "--threads must be from 1 to %lu, not %s\n", MAX_THREADS, argv[i]);
+                return 2;
+            }
+            threadCount = value;
+        }
+        else if (strcmp(argv[i], "--max-missed-repeats") == 0 && i + 1 < argc)
+        {
+            if (!parseCount(argv[++i], 0, 255, value))
+            {
+                fprintf(stderr, "--max-missed-repeats must be from 0 to 255, not %s\n", argv[i]);
+                return 2;
+            }
+            options.MaxMissedRepeats = value;
+        }
+        else paths.push_back(argv[i]);
+    }
+    if (paths.empty())
+    {
+        fprintf(stderr, "Usage: %s [--threads N] [--max-missed-repeats N] capture...\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<std::string> failedPaths;
+    auto const metrics = ReplayCorpus(paths, threadCount, options, failedPaths);
+
+    printf("Captures replayed:  %lu\n", metrics.Captures);
+    printf("Captures failed:    %lu\n", metrics.FailedCaptures);
+    printf("Edges:              %llu\n", metrics.Edges);
+    printf("Codes decoded:      %lu\n", metrics.Codes);
+    printf("Repeats decoded:    %lu\n", metrics.Repeats);
+    printf("Motor starts:       %lu\n", metrics.MotorStarts);
+    printf("Motor stutters:     %lu\n", metrics.Stutters);
+    printf("Time moving (ms):   %llu\n", metrics.MovingMicros / 1000ULL);
+    printf("Time braking (ms):  %llu\n", metrics.BrakingMicros / 1000ULL);
+    if (metrics.StopsMeasured)
+    {
+        printf("Stop latency (ms):  %llu (mean of %lu)\n", metrics.StopLatencyMicros / 1000ULL / metrics.StopsMeasured, metrics.StopsMeasured);
+    }
+    for (auto const & path : failedPaths) fprintf(stderr, "Could not read %s\n", path.c_str());
+    return failedPaths.empty() ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+/**
+ * Simulates a small brushed DC motor driven by the motor state machine,
+ * to compare the peak motor current when the direction is reversed,
+ * and the stopping latency, with and without a reversal brake interval
+ *
+ * Build and run on the host, from the repository root:
+ *   g++ -std=gnu++17 -O2 -Wall -Wextra -DHAL_HOST -I. tools/ReversalSimulation.cpp -o ReversalSimulation
+ *   ./ReversalSimulation
+ */
+#include <math.h>
+#include <stdio.h>
+#include "Simulation.h"
+#include "VolumeMotorStateMachine.h"
+
+using namespace SimulationUtils;
+using namespace VolumeMotorUtils;
+
+namespace
+{
+    int const VOLUME_UP_PIN = 4;
+    int const VOLUME_DOWN_PIN = 3;
+    unsigned long const VOLUME_UP_CODE = 0xFFA857;
+    unsigned long const VOLUME_DOWN_CODE = 0xFFE01F;
+    unsigned long const LOOP_PERIOD_MICROS = 50UL;
+    unsigned long const MODEL_STEP_MICROS = 5UL;
+
+    // A small 5V motor, as found in motorised potentiometers
+    double const SUPPLY_VOLTS = 5.0;
+    double const RESISTANCE_OHMS = 10.0;
+    double const INDUCTANCE_HENRIES = 1e-3;
+    double const TORQUE_CONSTANT = 0.005; // Nm/A, and V/(rad/s)
+    double const INERTIA = 7.5e-8; // kg m^2, for a 30ms mechanical time constant
+    double const FRICTION = 1e-7; // Nm/(rad/s)
+
+    struct Result
+    {
+        double PeakAmps;
+        unsigned long StopLatencyMicros; // From the last packet until the motor stops being driven
+    };
+
+    /**
+     * @param schedule Schedules the packets to send, and returns the time of the last
+     */
+    template <class TSchedule> Result simulate(TSchedule schedule, unsigned long const reversalBrakeMicros, unsigned long const reversalDeadTimeMicros)
+    {
+        Hal::Host::Reset();
+        ScriptedIrReceiver receiver;
+        unsigned long const lastPacketMicros = schedule(receiver);
+        VolumeMotorStateMachine motorStateMachine(
+            receiver,
+            VolumeMotorConfig
+            {
+                .VolumeUpCode = VOLUME_UP_CODE,
+                .VolumeDownCode = VOLUME_DOWN_CODE,
+                .VolumeUpPin = VOLUME_UP_PIN,
+                .VolumeDownPin = VOLUME_DOWN_PIN,
+                .BrakeDurationMicros = 100UL * 1000UL,
+                .MovementTimeoutMicros = 120UL * 1000UL,
+                .SoftStartMicros = 0,
+                .SupplySagMillivolts = 0,
+                .IdlePowerDownMicros = 0,
+                .StatusLedPin = Hal::NO_PIN,
+                .MaxMissedRepeats = 0,
+                .ReversalBrakeMicros = reversalBrakeMicros,
+                .ReversalDeadTimeMicros = reversalDeadTimeMicros,
+                .MotorDeadTimeMicros = 0,
+                .MotorEnablePin = Hal::NO_PIN,
+                .ManualHoldOffMicros = 0
+            });
+        VirtualTimeDriver<VolumeMotorStateMachine> driver(motorStateMachine, LOOP_PERIOD_MICROS);
+
+        double amps = 0.0;
+        double radiansPerSecond = 0.0;
+        Result result { 0.0, 0 };
+        driver.RunUntil(lastPacketMicros + 500UL * 1000UL, [&]()
+        {
+            bool const up = Hal::Host::GetOutputLevel(VOLUME_UP_PIN);
+            bool const down = Hal::Host::GetOutputLevel(VOLUME_DOWN_PIN);
+            if (up != down && Hal::Micros() > lastPacketMicros)
+            {
+                result.StopLatencyMicros = Hal::Micros() - lastPacketMicros;
+            }
+            for (unsigned long step = 0; step < LOOP_PERIOD_MICROS; step += MODEL_STEP_MICROS)
+            {
+                double const seconds = MODEL_STEP_MICROS * 1e-6;
+                // Both outputs LOW leaves the motor coasting, and its current decays through the driver's diodes
+                if (!up && !down) amps = 0.0;
+                else
+                {
+                    double const volts = up == down ? 0.0 : up ? SUPPLY_VOLTS : -SUPPLY_VOLTS;
+                    amps += (volts - RESISTANCE_OHMS * amps - TORQUE_CONSTANT * radiansPerSecond) / INDUCTANCE_HENRIES * seconds;
+                }
+                radiansPerSecond += (TORQUE_CONSTANT * amps - FRICTION * radiansPerSecond) / INERTIA * seconds;
+                if (fabs(amps) > result.PeakAmps) result.PeakAmps = fabs(amps);
+            }
+            return true;
+        });
+        return result;
+    }
+}
+
+int main()
+{
+    // Hold volume up for a second, then switch straight to volume down
+    auto const reversal = [](ScriptedIrReceiver & receiver)
+    {
+        unsigned long const reverseMicros = 10UL * 1000UL + 9 * REPEAT_PERIOD_MICROS + 60UL * 1000UL;
+        receiver.ScheduleHold(10UL * 1000UL, VOLUME_UP_CODE, 9);
+        receiver.ScheduleHold(reverseMicros, VOLUME_DOWN_CODE, 9);
+        return reverseMicros + 9 * REPEAT_PERIOD_MICROS;
+    };
+
+    // Hold volume up for a second, then release
+    auto const stop = [](ScriptedIrReceiver & receiver)
+    {
+        receiver.ScheduleHold(10UL * 1000UL, VOLUME_UP_CODE, 9);
+        return 10UL * 1000UL + 9 * REPEAT_PERIOD_MICROS;
+    };
+
+    printf("Stall current: %.2fA\n\n", SUPPLY_VOLTS / RESISTANCE_OHMS);
+    printf("Brake (ms)  Dead time (ms)  Reversal peak (A)  Stop latency (ms)\n");
+    unsigned long const settings[][2] = { { 0, 0 }, { 20, 0 }, { 50, 0 }, { 50, 1 }, { 100, 0 } };
+    for (auto const & setting : settings)
+    {
+        auto const reversed = simulate(reversal, setting[0] * 1000UL, setting[1] * 1000UL);
+        auto const stopped = simulate(stop, setting[0] * 1000UL, setting[1] * 1000UL);
+        printf(
+            "%10lu  %14lu  %17.2f  %17.1f\n",
+            setting[0],
+            setting[1],
+            reversed.PeakAmps,
+            stopped.StopLatencyMicros / 1000.0);
+    }
+    return 0;
+}